@@ -0,0 +1,527 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "../lib/jobsystem.h"
+#include "../lib/job.h"
+#include "../lib/joballocator.h"
+#include "../lib/jobtopology.h"
+#include "../lib/jobmutex.h"
+#include "../parsingjob.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+// Counts every trip to the global allocator, including the ones made inside libjob
+static std::atomic<unsigned long long> s_numGlobalAllocations{0};
+
+void *operator new(size_t size)
+{
+    s_numGlobalAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *block = std::malloc(size == 0 ? 1 : size);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void *block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    std::free(block);
+}
+
+// Bit for jobs in the mixed channel benchmark that only some workers serve
+constexpr unsigned long BENCH_CHANNEL_CUSTOM = 1UL << 2;
+
+// Every benchmark gets a job system of its own, so one benchmark's pools and queues never skew the next
+static JobSystem *CreateBenchJobSystem(int numWorkers)
+{
+    JobSystem *jobSystem = new JobSystem();
+    for (int n = 0; n < numWorkers; ++n)
+    {
+        std::string threadName = "Bench Thread " + std::to_string(n);
+        jobSystem->CreateWorkerThread(threadName.c_str(), 0xFFFFFFFF);
+    }
+    return jobSystem;
+}
+
+static double ElapsedUs(BenchClock::time_point startTime, BenchClock::time_point endTime)
+{
+    return std::chrono::duration<double, std::micro>(endTime - startTime).count();
+}
+
+// Waits for every job in the batch, FinishCompletedJobs() only retires the ones that completed already
+static void WaitForAll(const std::vector<JobHandle> &jobHandles)
+{
+    for (const JobHandle &jobHandle : jobHandles)
+    {
+        jobHandle.Wait();
+    }
+}
+
+// Shared state for one dependency chain, filled in by the jobs as they run
+struct ChainState
+{
+    std::vector<BenchClock::time_point> m_executeTimes;
+    int m_jobsExecuted = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_doneCondition;
+};
+
+static ChainState *s_chainState = nullptr;
+
+// Empty job that only records when it ran. The chain runs one job at a time, so the
+// number of jobs executed so far is its place in the chain
+class ChainJob : public Job
+{
+public:
+    ChainJob() = default;
+    ~ChainJob(){};
+
+    void Execute() override
+    {
+        std::lock_guard<std::mutex> lock(s_chainState->m_mutex);
+        s_chainState->m_executeTimes[s_chainState->m_jobsExecuted] = BenchClock::now();
+        s_chainState->m_jobsExecuted++;
+        s_chainState->m_doneCondition.notify_all();
+    }
+};
+
+// Runs a chain of chainLength jobs where each job depends on the previous one,
+// and reports the average latency of one hop (completion to dependent executing)
+static nlohmann::json RunChainBenchmark(int chainLength, int numWorkers)
+{
+    JobSystem *jobSystem = CreateBenchJobSystem(numWorkers);
+    chainLength = std::max(chainLength, 2);
+
+    ChainState chainState;
+    chainState.m_executeTimes.resize(chainLength);
+    s_chainState = &chainState;
+
+    jobSystem->RegisterJobType("chainJob", []() -> Job *
+                               { return new ChainJob(); });
+
+    // One type, the links are told apart by their names within the run
+    JobRunID runID = jobSystem->CreateGraphRun();
+    std::vector<JobID> jobIDs;
+    for (int i = 0; i < chainLength; ++i)
+    {
+        std::string jobName = "chainJob" + std::to_string(i);
+        nlohmann::json input = nlohmann::json::object();
+        nlohmann::json creation = jobSystem->CreateJob("chainJob", input, runID, jobName);
+        jobIDs.push_back(creation["jobId"]);
+
+        if (i > 0)
+        {
+            jobSystem->SetDependency(runID, jobName, "chainJob" + std::to_string(i - 1));
+        }
+    }
+
+    // Every link is queued up front, each one waits on the one before it. Queueing the first starts the chain
+    for (int i = 1; i < chainLength; ++i)
+    {
+        jobSystem->QueueJob(jobIDs[i]);
+    }
+    BenchClock::time_point startTime = BenchClock::now();
+    jobSystem->QueueJob(jobIDs[0]);
+
+    {
+        std::unique_lock<std::mutex> lock(chainState.m_mutex);
+        chainState.m_doneCondition.wait(lock, [&chainState, chainLength]()
+                                        { return chainState.m_jobsExecuted == chainLength; });
+    }
+
+    nlohmann::json metrics;
+    metrics["submitToFirstUs"] = ElapsedUs(startTime, chainState.m_executeTimes.front());
+    metrics["perHopUs"] = ElapsedUs(chainState.m_executeTimes.front(), chainState.m_executeTimes.back()) / (chainLength - 1);
+    metrics["totalMs"] = ElapsedUs(startTime, chainState.m_executeTimes.back()) / 1000.0;
+
+    delete jobSystem;
+    s_chainState = nullptr;
+    return metrics;
+}
+
+// Job that burns a fixed amount of CPU so the fan-out measures parallel speedup
+class SpinJob : public Job
+{
+public:
+    SpinJob(int iterations) : m_iterations(iterations) {}
+    ~SpinJob(){};
+
+    void Execute() override
+    {
+        volatile unsigned long long sum = 0;
+        for (int i = 0; i < m_iterations; ++i)
+        {
+            sum = sum + (unsigned long long)i * i;
+        }
+    }
+
+private:
+    int m_iterations = 0;
+};
+
+// Runs one root job with fanOutWidth dependents that all feed one sink, and reports the wall time for
+// the whole graph. The leaves are short enough that releasing and completing them shows up in the total
+static nlohmann::json RunFanOutBenchmark(int fanOutWidth, int numWorkers)
+{
+    const int spinIterations = 20000;
+    JobSystem *jobSystem = CreateBenchJobSystem(numWorkers);
+
+    jobSystem->RegisterJobType("fanOutEdge", []() -> Job *
+                               { return new SpinJob(0); });
+    jobSystem->RegisterJobType("fanOutLeaf", [spinIterations]() -> Job *
+                               { return new SpinJob(spinIterations); });
+
+    nlohmann::json graphSpec;
+    graphSpec["jobs"] = nlohmann::json::array();
+    graphSpec["edges"] = nlohmann::json::array();
+    graphSpec["jobs"].push_back({{"name", "root"}, {"type", "fanOutEdge"}});
+    graphSpec["jobs"].push_back({{"name", "sink"}, {"type", "fanOutEdge"}});
+    for (int i = 0; i < fanOutWidth; ++i)
+    {
+        std::string leafName = "leaf" + std::to_string(i);
+        graphSpec["jobs"].push_back({{"name", leafName}, {"type", "fanOutLeaf"}});
+        graphSpec["edges"].push_back({{"dependent", leafName}, {"dependency", "root"}});
+        graphSpec["edges"].push_back({{"dependent", "sink"}, {"dependency", leafName}});
+    }
+
+    BenchClock::time_point startTime = BenchClock::now();
+    nlohmann::json submission = jobSystem->SubmitGraph(graphSpec);
+    BenchClock::time_point submittedTime = BenchClock::now();
+
+    JobHandle sinkHandle = jobSystem->GetJobHandle(submission["jobIds"]["sink"].get<JobID>());
+    sinkHandle.Wait();
+    BenchClock::time_point endTime = BenchClock::now();
+
+    std::vector<JobHandle> jobHandles;
+    for (const auto &jobID : submission["jobIds"])
+    {
+        jobHandles.push_back(jobSystem->GetJobHandle(jobID.get<JobID>()));
+    }
+    WaitForAll(jobHandles);
+    jobSystem->FinishCompletedJobs();
+
+    nlohmann::json metrics;
+    metrics["submitUs"] = ElapsedUs(startTime, submittedTime);
+    metrics["totalMs"] = ElapsedUs(startTime, endTime) / 1000.0;
+    // What the leaves would take back to back on one worker, next to totalMs this is the speedup
+    metrics["spinIterationsPerLeaf"] = spinIterations;
+
+    delete jobSystem;
+    return metrics;
+}
+
+// Empty job for measuring scheduler overhead
+class EmptyJob : public Job
+{
+public:
+    EmptyJob(unsigned long jobChannels = JOB_CHANNEL_CPU) : Job(jobChannels) {}
+    ~EmptyJob(){};
+
+    void Execute() override {}
+};
+
+// Creates, queues, runs and retires jobCount empty jobs in rounds, and reports the throughput and how
+// many global allocations the scheduler made per job once the pools are warm. The jobs share one input
+// and are created without a JSON response, which costs the JSON CreateJob() a few more allocations
+static nlohmann::json RunEmptyJobBenchmark(int jobCount, int numWorkers)
+{
+    const int jobsPerRound = 1000;
+    JobSystem *jobSystem = CreateBenchJobSystem(numWorkers);
+
+    jobSystem->RegisterJobType("emptyJob", []() -> Job *
+                               { return new EmptyJob(); });
+    Job::Payload input = Job::MakePayload(nlohmann::json::object());
+    const std::string jobType = "emptyJob";
+    std::string createError;
+
+    std::vector<JobHandle> jobHandles;
+    jobHandles.reserve(jobsPerRound);
+    auto runRound = [jobSystem, &input, &jobType, &createError, &jobHandles](int numJobs)
+    {
+        jobHandles.clear();
+        for (int i = 0; i < numJobs; ++i)
+        {
+            JobID jobID = jobSystem->CreateJob(jobType, input, DEFAULT_JOB_RUN_ID, jobType, createError);
+            jobHandles.push_back(jobSystem->QueueJob(jobID));
+        }
+        WaitForAll(jobHandles);
+        jobSystem->FinishCompletedJobs();
+    };
+
+    // Warm up so the pools and containers have reached their steady state size
+    runRound(jobsPerRound);
+
+    int jobsRun = 0;
+    unsigned long long allocationsBefore = s_numGlobalAllocations.load();
+    BenchClock::time_point startTime = BenchClock::now();
+    while (jobsRun < jobCount)
+    {
+        runRound(jobsPerRound);
+        jobsRun += jobsPerRound;
+    }
+    double totalMs = ElapsedUs(startTime, BenchClock::now()) / 1000.0;
+    unsigned long long allocations = s_numGlobalAllocations.load() - allocationsBefore;
+
+    nlohmann::json metrics;
+    metrics["jobsRun"] = jobsRun;
+    metrics["jobsPerSecond"] = (jobsRun / totalMs) * 1000.0;
+    metrics["globalAllocationsPerJob"] = (double)allocations / jobsRun;
+    metrics["jobPoolSlabs"] = JobAllocator::GetNumSlabs();
+
+    delete jobSystem;
+    return metrics;
+}
+
+// Empty jobs spread over four channel masks, on workers that each serve only part of them. Exercises
+// the per-mask ready queues and stealing between workers that cannot run each other's jobs
+static nlohmann::json RunChannelBenchmark(int jobCount, int numWorkers)
+{
+    const unsigned long workerChannels[] = {JOB_CHANNEL_CPU, JOB_CHANNEL_IO, JOB_CHANNEL_CPU | BENCH_CHANNEL_CUSTOM};
+    const char *jobTypes[] = {"cpuJob", "ioJob", "customJob", "anyJob"};
+    const unsigned long jobChannels[] = {JOB_CHANNEL_CPU, JOB_CHANNEL_IO, BENCH_CHANNEL_CUSTOM, JOB_CHANNEL_CPU | JOB_CHANNEL_IO};
+
+    // The first worker serves everything so every mask has somewhere to run with a single worker
+    JobSystem *jobSystem = new JobSystem();
+    for (int n = 0; n < numWorkers; ++n)
+    {
+        std::string threadName = "Bench Thread " + std::to_string(n);
+        jobSystem->CreateWorkerThread(threadName.c_str(), (n == 0) ? JOB_CHANNEL_ALL : workerChannels[(n - 1) % 3]);
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        unsigned long channels = jobChannels[i];
+        jobSystem->RegisterJobType(jobTypes[i], [channels]() -> Job *
+                                   { return new EmptyJob(channels); });
+    }
+
+    nlohmann::json input = nlohmann::json::object();
+    std::vector<JobHandle> jobHandles;
+    jobHandles.reserve(jobCount);
+
+    BenchClock::time_point startTime = BenchClock::now();
+    for (int i = 0; i < jobCount; ++i)
+    {
+        JobID jobID = jobSystem->CreateJob(jobTypes[i % 4], input)["jobId"];
+        jobHandles.push_back(jobSystem->QueueJob(jobID));
+    }
+    WaitForAll(jobHandles);
+    double totalMs = ElapsedUs(startTime, BenchClock::now()) / 1000.0;
+    jobSystem->FinishCompletedJobs();
+
+    nlohmann::json metrics;
+    metrics["jobsRun"] = jobCount;
+    metrics["jobsPerSecond"] = (jobCount / totalMs) * 1000.0;
+
+    delete jobSystem;
+    return metrics;
+}
+
+// Queues one empty job at a time and finishes it right away, so every FinishJob() has to wait
+// for a worker to wake up, run the job and signal the handle
+static nlohmann::json RunFinishLatencyBenchmark(int jobCount, int numWorkers)
+{
+    JobSystem *jobSystem = CreateBenchJobSystem(numWorkers);
+    jobSystem->RegisterJobType("emptyJob", []() -> Job *
+                               { return new EmptyJob(); });
+    nlohmann::json input = nlohmann::json::object();
+
+    std::vector<double> latenciesUs;
+    latenciesUs.reserve(jobCount);
+    for (int i = 0; i < jobCount; ++i)
+    {
+        JobID jobID = jobSystem->CreateJob("emptyJob", input)["jobId"];
+        BenchClock::time_point startTime = BenchClock::now();
+        JobHandle jobHandle = jobSystem->QueueJob(jobID);
+        jobSystem->FinishJob(jobHandle);
+        latenciesUs.push_back(ElapsedUs(startTime, BenchClock::now()));
+    }
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+
+    double sumUs = 0.0;
+    for (double latencyUs : latenciesUs)
+    {
+        sumUs += latencyUs;
+    }
+
+    nlohmann::json metrics;
+    metrics["averageUs"] = sumUs / jobCount;
+    metrics["p50Us"] = latenciesUs[jobCount / 2];
+    metrics["p99Us"] = latenciesUs[(jobCount * 99) / 100];
+    metrics["maxUs"] = latenciesUs.back();
+
+    delete jobSystem;
+    return metrics;
+}
+
+// The real parse job on a synthetic compiler log, without printing its output when it is finished
+class BenchParsingJob : public ParsingJob
+{
+public:
+    void JobCompleteCallback() override {}
+};
+
+// Runs jobCount parse jobs on numWorkers workers placed by the policy, returns jobs per second
+static double MeasureParseThroughput(JobPlacementPolicy placementPolicy, int jobCount, int numWorkers, const nlohmann::json &input)
+{
+    JobSystem *jobSystem = new JobSystem();
+    for (int n = 0; n < numWorkers; ++n)
+    {
+        std::string threadName = "Bench Thread " + std::to_string(n);
+        jobSystem->CreateWorkerThread(threadName.c_str(), 0xFFFFFFFF, JobTopology::GetSpreadPlacement(placementPolicy, n));
+    }
+    jobSystem->RegisterJobType("parseJob", []() -> Job *
+                               { return new BenchParsingJob(); });
+
+    nlohmann::json parseInput = input;
+    BenchClock::time_point startTime = BenchClock::now();
+    std::vector<JobHandle> jobHandles;
+    for (int i = 0; i < jobCount; ++i)
+    {
+        JobID jobID = jobSystem->CreateJob("parseJob", parseInput)["jobId"];
+        jobHandles.push_back(jobSystem->QueueJob(jobID));
+    }
+    WaitForAll(jobHandles);
+    double totalMs = ElapsedUs(startTime, BenchClock::now()) / 1000.0;
+
+    jobSystem->FinishCompletedJobs();
+    delete jobSystem;
+    return (jobCount / totalMs) * 1000.0;
+}
+
+// Compares parse throughput with workers left to the OS, bound to NUMA nodes and pinned to cores
+static nlohmann::json RunParseBenchmark(int jobCount, int numWorkers)
+{
+    // A compile log with a few hundred errors, about what a broken translation unit produces
+    std::string compileOutput;
+    for (int i = 0; i < 300; ++i)
+    {
+        compileOutput += "./Code/main.cpp:" + std::to_string(i + 1) + ":5: error: use of undeclared identifier 'x" + std::to_string(i) + "'\n";
+        compileOutput += "    int y = x" + std::to_string(i) + ";\n";
+    }
+    nlohmann::json input;
+    input["output"] = compileOutput;
+
+    // Warm up the pools and the regex code paths
+    MeasureParseThroughput(JOB_PLACEMENT_NONE, numWorkers, numWorkers, input);
+
+    nlohmann::json metrics;
+    metrics["numaNodes"] = JobTopology::GetNumaNodes().size();
+    metrics["cores"] = JobTopology::GetNumCores();
+    metrics["unpinnedJobsPerSecond"] = MeasureParseThroughput(JOB_PLACEMENT_NONE, jobCount, numWorkers, input);
+    metrics["numaNodesJobsPerSecond"] = MeasureParseThroughput(JOB_PLACEMENT_NUMA_NODES, jobCount, numWorkers, input);
+    metrics["coresJobsPerSecond"] = MeasureParseThroughput(JOB_PLACEMENT_CORES, jobCount, numWorkers, input);
+    return metrics;
+}
+
+struct BenchmarkEntry
+{
+    const char *m_name;
+    nlohmann::json (*m_run)(int jobCount, int numWorkers);
+    // Used when the command line does not give a job count
+    int m_defaultJobCount;
+    // Part of "all", the parse benchmark measures the parse job more than the scheduler
+    bool m_isInSuite;
+};
+
+static const BenchmarkEntry s_benchmarks[] = {
+    {"empty", RunEmptyJobBenchmark, 20000, true},
+    {"chain", RunChainBenchmark, 1000, true},
+    {"fanout", RunFanOutBenchmark, 256, true},
+    {"channels", RunChannelBenchmark, 20000, true},
+    {"finish", RunFinishLatencyBenchmark, 2000, true},
+    {"parse", RunParseBenchmark, 200, false},
+};
+
+// 1, 2, 4, ... up to maxWorkers, ending on maxWorkers itself
+static std::vector<int> GetWorkerCounts(int maxWorkers)
+{
+    std::vector<int> workerCounts;
+    for (int numWorkers = 1; numWorkers < maxWorkers; numWorkers *= 2)
+    {
+        workerCounts.push_back(numWorkers);
+    }
+    workerCounts.push_back(maxWorkers);
+    return workerCounts;
+}
+
+int main(int argc, char *argv[])
+{
+    // Usage: schedulerbench [all|empty|chain|fanout|channels|finish|parse] [jobCount] [maxWorkers]
+    // Every benchmark runs at each worker count up to maxWorkers. Results go to stdout as one JSON
+    // document, progress to stderr, so the output can be redirected and compared between builds
+    std::string benchmark = "all";
+    int jobCount = 0;
+    int maxWorkers = std::max(1, (int)std::thread::hardware_concurrency());
+    if (argc > 1)
+    {
+        benchmark = argv[1];
+    }
+    if (argc > 2)
+    {
+        jobCount = std::stoi(argv[2]);
+    }
+    if (argc > 3)
+    {
+        maxWorkers = std::max(1, std::stoi(argv[3]));
+    }
+
+    nlohmann::json report;
+    report["benchmark"] = benchmark;
+    report["hardwareThreads"] = std::thread::hardware_concurrency();
+    report["results"] = nlohmann::json::array();
+
+    bool foundBenchmark = false;
+    for (const BenchmarkEntry &entry : s_benchmarks)
+    {
+        if ((benchmark != entry.m_name) && !((benchmark == "all") && entry.m_isInSuite))
+        {
+            continue;
+        }
+        foundBenchmark = true;
+
+        int entryJobCount = (jobCount > 0) ? jobCount : entry.m_defaultJobCount;
+        for (int numWorkers : GetWorkerCounts(maxWorkers))
+        {
+            std::cerr << entry.m_name << ": " << entryJobCount << " jobs on " << numWorkers << " workers" << std::endl;
+
+            nlohmann::json result;
+            result["name"] = entry.m_name;
+            result["jobCount"] = entryJobCount;
+            result["workers"] = numWorkers;
+            JobLockProfiler::Reset();
+            result["metrics"] = entry.m_run(entryJobCount, numWorkers);
+
+            // Only in builds with JOBSYSTEM_PROFILE_LOCKS, the lock waits of this run alone
+            nlohmann::json lockReport = JobLockProfiler::GetReport();
+            if (lockReport["enabled"].get<bool>())
+            {
+                result["locks"] = std::move(lockReport["locks"]);
+            }
+            report["results"].push_back(std::move(result));
+        }
+    }
+
+    if (!foundBenchmark)
+    {
+        std::cerr << "Unknown benchmark: " << benchmark << std::endl;
+        return 1;
+    }
+
+    std::cout << report.dump(2) << std::endl;
+    return 0;
+}
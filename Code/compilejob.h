@@ -1,23 +1,26 @@
 #pragma once
-#include "./lib/job.h"
+#include "./lib/processjob.h"
 #include <iostream>
 #include <string>
 #include <array>
 
-class CompileJob : public Job
+class CompileJob : public ProcessJob
 {
 public:
+    // Runs the compiler through the job system's reactor, no worker waits on the child
     CompileJob() = default;
     CompileJob(nlohmann::json input);
     ~CompileJob(){};
 
-    void Execute() override;
-
     void JobCompleteCallback() override;
 
     std::string output;
     int returnCode;
 
+protected:
+    std::string GetCommand() override;
+    void OnProcessExit(const std::string &processOutput, int exitCode) override;
+
 private:
     nlohmann::json m_compileJobInput;
-};
\ No newline at end of file
+};
@@ -0,0 +1,70 @@
+#include "correctionjob.h"
+#include <iostream>
+
+JobTask CorrectionJob::Run()
+{
+    // Hold on to the input payload while we read it
+    Payload input = GetInput();
+    std::string gptCallCommand = input->value("gptCallCommand", "");
+    std::string codeCorrectionCommand = input->value("codeCorrectionCommand", "");
+
+    nlohmann::json jsonOutput;
+    if (gptCallCommand.empty() || codeCorrectionCommand.empty())
+    {
+        std::cout << "Correction Job: Missing 'gptCallCommand' or 'codeCorrectionCommand' in input JSON" << std::endl;
+        jsonOutput["status"] = "bad input";
+        SetOutput(std::move(jsonOutput));
+        co_return;
+    }
+
+    // The corrected code is written by the time the LLM call exits, no need to wait on the file
+    JobProcessResult gptCall = co_await JobProcess(gptCallCommand);
+    jsonOutput["gptCall"] = DescribeStep(gptCall);
+    if (gptCall.m_exitCode != 0)
+    {
+        jsonOutput["status"] = IsCancelled() ? "cancelled" : "gptCall failed";
+        SetOutput(std::move(jsonOutput));
+        // The LLM call is the flaky step, failing it lets the retry policy run the job again
+        SetExitCode(EXIT_GPT_CALL_FAILED);
+        co_return;
+    }
+
+    JobProcessResult codeCorrection = co_await JobProcess(codeCorrectionCommand);
+    jsonOutput["codeCorrection"] = DescribeStep(codeCorrection);
+    if (IsCancelled())
+    {
+        jsonOutput["status"] = "cancelled";
+    }
+    else
+    {
+        jsonOutput["status"] = (codeCorrection.m_exitCode == 0) ? "completed" : "codeCorrection failed";
+    }
+    SetExitCode((codeCorrection.m_exitCode == 0) ? 0 : EXIT_CODE_CORRECTION_FAILED);
+
+    // Set output JSON, moved into the shared payload instead of copied
+    SetOutput(std::move(jsonOutput));
+}
+
+nlohmann::json CorrectionJob::DescribeStep(const JobProcessResult &result)
+{
+    nlohmann::json step;
+    step["returnCode"] = result.m_exitCode;
+    step["output"] = result.m_output;
+    step["durationMs"] = std::chrono::duration<double, std::milli>(result.m_runningTime).count();
+    if (!result.m_spawnError.empty())
+    {
+        step["error"] = result.m_spawnError;
+    }
+    return step;
+}
+
+void CorrectionJob::JobCompleteCallback()
+{
+    std::cout << "Correction Job " << this->GetUniqueID() << " has been completed, the output is:" << std::endl;
+    std::cout << this->GetOutput()->dump(4) << std::endl;
+
+    if (jobSystem != nullptr)
+    {
+        jobSystem->StoreJobOutput(this->GetUniqueID(), *this->GetOutput());
+    }
+}
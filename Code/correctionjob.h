@@ -0,0 +1,31 @@
+#pragma once
+#include "./lib/coroutinejob.h"
+#include "./lib/jobsystemapi.h"
+#include <string>
+#include <nlohmann/json.hpp>
+
+// Runs the LLM call and then the code correction script one after the other. Each step is a
+// subprocess the job co_awaits, so no worker is held and nothing polls the files they write.
+// A timeout or cancel stops the script that is running and skips the rest
+class CorrectionJob : public CoroutineJob
+{
+public:
+    // The job's exit code says which script failed, each script's own code is in the output. Only a
+    // failed LLM call is worth retrying, rerunning the job for a failed patch would pay for the call again
+    static constexpr int EXIT_GPT_CALL_FAILED = 1;
+    static constexpr int EXIT_CODE_CORRECTION_FAILED = 2;
+
+    // The output, with how long each script ran, is kept in the API for runFlowScript to read
+    CorrectionJob(JobSystemAPI *jobSystem = nullptr) : jobSystem(jobSystem) {}
+    ~CorrectionJob(){};
+
+    void JobCompleteCallback() override;
+
+protected:
+    JobTask Run() override;
+
+private:
+    static nlohmann::json DescribeStep(const JobProcessResult &result);
+
+    JobSystemAPI *jobSystem = nullptr;
+};
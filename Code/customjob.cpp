@@ -8,54 +8,41 @@ CustomJob::CustomJob(nlohmann::json input) : m_compileJobInput(input)
     this->SetInput(input);
 }
 
-void CustomJob::Execute()
+std::string CustomJob::GetCommand()
 {
-    std::array<char, 128> buffer;
+    // Hold on to the input payload while we read it
+    Payload input = GetInput();
 
-    if (!GetInput().contains("command"))
+    if (!input->contains("command"))
     {
         std::cout << "Custom Job: Missing 'command' in input JSON" << std::endl;
-        return;
+        return std::string();
     }
-    else if (GetInput().contains("error"))
+    else if (input->contains("error"))
     {
         std::cout << "Custom Job: Error in input JSON, 'bad input'" << std::endl;
-        return;
+        return std::string();
     }
 
-    std::string command = GetInput()["command"];
-
-    // Redirect cerr to cout | capture errors and send to cout:
-    command.append(" 2>&1");
-
-    // Open pipe and run command:
-    FILE *pipe = popen(command.c_str(), "r");
-    if (!pipe)
-    {
-        std::cout << "popen Failed: Failed to open pipe" << std::endl;
-        return;
-    }
+    return (*input)["command"];
+}
 
-    // Read till end of process
-    while (fgets(buffer.data(), 128, pipe) != nullptr)
-    {
-        this->output.append(buffer.data());
-    }
+void CustomJob::OnProcessExit(const std::string &processOutput, int exitCode)
+{
+    this->output = processOutput;
+    this->returnCode = exitCode;
 
     nlohmann::json jsonOutput;
     jsonOutput["status"] = "completed";
     jsonOutput["output"] = output;
 
-    // Set output JSON
-    this->SetOutput(jsonOutput);
-
-    // Close pipe and get return code
-    this->returnCode = pclose(pipe);
+    // Set output JSON, moved into the shared payload instead of copied
+    this->SetOutput(std::move(jsonOutput));
 }
 
 void CustomJob::JobCompleteCallback()
 {
     std::cout << "Custom Job " << this->GetUniqueID() << " has been completed, the output is:" << std::endl;
-    std::string jsonOuput = this->GetOutput().dump(4);
+    std::string jsonOuput = this->GetOutput()->dump(4);
     std::cout << jsonOuput << std::endl;
-}
\ No newline at end of file
+}
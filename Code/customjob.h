@@ -1,23 +1,26 @@
 #pragma once
-#include "./lib/job.h"
+#include "./lib/processjob.h"
 #include <iostream>
 #include <string>
 #include <array>
 
-class CustomJob : public Job
+class CustomJob : public ProcessJob
 {
 public:
+    // Runs its command through the job system's reactor, no worker waits on the child
     CustomJob() = default;
     CustomJob(nlohmann::json input);
     ~CustomJob(){};
 
-    void Execute() override;
-
     void JobCompleteCallback() override;
 
     std::string output;
     int returnCode;
 
+protected:
+    std::string GetCommand() override;
+    void OnProcessExit(const std::string &processOutput, int exitCode) override;
+
 private:
     nlohmann::json m_compileJobInput;
-};
\ No newline at end of file
+};
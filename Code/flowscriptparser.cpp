@@ -23,7 +23,8 @@ void FlowScriptParseJob::Execute()
     std::vector<Token> tokens;
     try
     {
-        tokens = Tokenize(this->GetInput()["flowscript"].get<std::string>());
+        Payload input = this->GetInput();
+        tokens = Tokenize((*input)["flowscript"].get<std::string>());
     }
     catch (const std::invalid_argument &e)
     {
@@ -60,11 +61,23 @@ void FlowScriptParseJob::Execute()
             {
                 nodeJson["inputData"] = node.inputData;
             }
+            if (!node.priority.empty())
+            {
+                nodeJson["priority"] = node.priority;
+            }
+            if (node.deadlineMs >= 0)
+            {
+                nodeJson["deadlineMs"] = node.deadlineMs;
+            }
+            if (node.retries >= 0)
+            {
+                nodeJson["retries"] = node.retries;
+            }
 
             graphJson[id] = nodeJson;
         }
 
-        this->SetOutput(graphJson);
+        this->SetOutput(std::move(graphJson));
     }
     catch (const std::invalid_argument &e)
     {
@@ -76,10 +89,10 @@ void FlowScriptParseJob::Execute()
 void FlowScriptParseJob::JobCompleteCallback()
 {
     // // Output the JSON representation of the graph
-    nlohmann::json jsonOutput = this->GetOutput();
+    Payload jsonOutput = this->GetOutput();
     if (jobSystem != nullptr)
     {
-        jobSystem->StoreJobOutput(this->GetUniqueID(), jsonOutput);
+        jobSystem->StoreJobOutput(this->GetUniqueID(), *jsonOutput);
     }
     else
     {
@@ -412,6 +425,51 @@ void FlowScriptParseJob::parseNodeProperties(std::vector<Token> &tokens, int &to
             }
             break;
 
+        case IDENTIFIER:
+        {
+            // priority="high", deadline="500" (milliseconds) and retries="2" are plain identifiers to the tokenizer
+            std::string propertyName = tokens[tokenIndex].lexeme;
+            tokenIndex++; // Move past the property name
+            if ((propertyName == "priority" || propertyName == "deadline" || propertyName == "retries") &&
+                tokenIndex < tokens.size() && tokens[tokenIndex].type == EQUALS)
+            {
+                tokenIndex++; // Move past '='
+                if (tokenIndex < tokens.size() && tokens[tokenIndex].type == STRING_LITERAL)
+                {
+                    // Strip the surrounding quotes
+                    std::string value = tokens[tokenIndex].lexeme.substr(1, tokens[tokenIndex].lexeme.size() - 2);
+                    if (propertyName == "priority")
+                    {
+                        node.priority = value;
+                    }
+                    else if (propertyName == "retries")
+                    {
+                        try
+                        {
+                            node.retries = std::stoi(value);
+                        }
+                        catch (const std::exception &)
+                        {
+                            throw std::invalid_argument("Invalid retries for node: " + node.id);
+                        }
+                    }
+                    else
+                    {
+                        try
+                        {
+                            node.deadlineMs = std::stoll(value);
+                        }
+                        catch (const std::exception &)
+                        {
+                            throw std::invalid_argument("Invalid deadline for node: " + node.id);
+                        }
+                    }
+                    tokenIndex++; // Move past string literal
+                }
+            }
+            break;
+        }
+
         default:
             tokenIndex++; // Skip unrecognized property tokens
             break;
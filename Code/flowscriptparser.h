@@ -45,6 +45,10 @@ public:
         nlohmann::json inputData;
         std::string statusCondition;
         std::string output;
+        // Scheduling hints from the priority, deadline and retries attributes, passed on to CreateJob
+        std::string priority;
+        long long deadlineMs = -1;
+        int retries = -1;
     };
 
     std::vector<Token> Tokenize(std::string script);
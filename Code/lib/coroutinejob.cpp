@@ -0,0 +1,163 @@
+#include "coroutinejob.h"
+
+#ifdef JOBSYSTEM_HAS_COROUTINES
+#include <iostream>
+#include <exception>
+#include "jobsystem.h"
+
+void JobTask::promise_type::unhandled_exception()
+{
+    try
+    {
+        throw;
+    }
+    catch (const std::exception &exception)
+    {
+        m_job->OnUnhandledException(exception.what());
+    }
+    catch (...)
+    {
+        m_job->OnUnhandledException("unknown exception");
+    }
+}
+
+void JobTask::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept
+{
+    // Last thing we touch, the job and the frame may be deleted as soon as it is completed
+    coroutine.promise().m_job->CompleteDeferred();
+}
+
+JobTask::~JobTask()
+{
+    // Only set if the task was never handed to a job
+    if (m_coroutine)
+    {
+        m_coroutine.destroy();
+    }
+}
+
+std::coroutine_handle<JobTask::promise_type> JobTask::Release()
+{
+    std::coroutine_handle<promise_type> coroutine = m_coroutine;
+    m_coroutine = nullptr;
+    return coroutine;
+}
+
+CoroutineJob::~CoroutineJob()
+{
+    // A job deleted while suspended (the job system shutting down) takes its frame with it
+    if (m_coroutine)
+    {
+        m_coroutine.destroy();
+    }
+}
+
+void CoroutineJob::Execute()
+{
+    // Resumptions are posted to the job system, a job made outside of one has nowhere to resume
+    if (GetJobSystem() == nullptr)
+    {
+        OnUnhandledException("job was not created by a JobSystem");
+        return;
+    }
+
+    // A retried job starts a fresh coroutine, the last attempt's frame ended at its final suspend
+    if (m_coroutine)
+    {
+        m_coroutine.destroy();
+    }
+    m_coroutine = Run().Release();
+    m_coroutine.promise().m_job = this;
+
+    // Runs up to the first co_await that suspends, or to the end, in which case it completes right away
+    DeferCompletion();
+    m_coroutine.resume();
+}
+
+void CoroutineJob::ResumeOnWorker()
+{
+    std::coroutine_handle<JobTask::promise_type> coroutine = m_coroutine;
+    GetJobSystem()->Post([coroutine]()
+                         { coroutine.resume(); },
+                         GetJobChannels());
+}
+
+void CoroutineJob::OnCancel()
+{
+    pid_t processID = m_awaitedProcessID.load();
+    if (processID > 0)
+    {
+        GetJobSystem()->GetReactor().TerminateProcess(processID);
+    }
+}
+
+void CoroutineJob::OnUnhandledException(const std::string &reason)
+{
+    std::cerr << "Coroutine Job " << GetUniqueID() << ": " << reason << std::endl;
+    SetExitCode(-1);
+
+    nlohmann::json jsonOutput;
+    jsonOutput["status"] = "failed";
+    jsonOutput["error"] = reason;
+    SetOutput(std::move(jsonOutput));
+}
+
+void JobHandleAwaiter::await_suspend(std::coroutine_handle<JobTask::promise_type> coroutine)
+{
+    // The continuation runs at once if the job completed since await_ready, that only posts the resume
+    CoroutineJob *job = coroutine.promise().m_job;
+    m_jobHandle.Then([job](const nlohmann::json &)
+                     { job->ResumeOnWorker(); });
+}
+
+Job::Payload JobHandleAwaiter::await_resume() const
+{
+    Job::Payload output = m_jobHandle.GetOutput();
+    return output ? output : Job::GetEmptyPayload();
+}
+
+bool JobProcess::await_suspend(std::coroutine_handle<JobTask::promise_type> coroutine)
+{
+    CoroutineJob *job = coroutine.promise().m_job;
+    if (job->IsCancelled())
+    {
+        m_result.m_spawnError = "job was cancelled";
+        return false;
+    }
+
+    // Once the child is watched it may exit and resume the coroutine, which can complete and delete the
+    // job, so neither the job nor this awaiter is touched after SpawnProcess() returns. The process ID
+    // is published before that, whichever of onSpawned and OnCancel() comes second stops the child
+    JobReactor &reactor = job->GetJobSystem()->GetReactor();
+    std::chrono::steady_clock::time_point spawnTime = std::chrono::steady_clock::now();
+    pid_t processID = reactor.SpawnProcess(m_command, [this, job, spawnTime](const std::string &output, int exitCode)
+                                           {
+                                               job->m_awaitedProcessID.store(-1);
+                                               m_result.m_output = output;
+                                               m_result.m_exitCode = exitCode;
+                                               m_result.m_runningTime = std::chrono::steady_clock::now() - spawnTime;
+                                               job->ResumeOnWorker(); },
+                                           m_result.m_spawnError,
+                                           [job](pid_t spawnedProcessID)
+                                           {
+                                               job->m_awaitedProcessID.store(spawnedProcessID);
+                                               return !job->IsCancelled(); });
+
+    // Not suspending carries on right away with the spawn error
+    return processID >= 0;
+}
+
+bool JobDelay::await_suspend(std::coroutine_handle<JobTask::promise_type> coroutine)
+{
+    CoroutineJob *job = coroutine.promise().m_job;
+    if (job->IsCancelled())
+    {
+        return false;
+    }
+
+    job->GetJobSystem()->GetReactor().AddTimer(std::chrono::steady_clock::now() + m_delay, [job]()
+                                               { job->ResumeOnWorker(); });
+    return true;
+}
+
+#endif
@@ -0,0 +1,141 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <sys/types.h>
+#include <nlohmann/json.hpp>
+#include "job.h"
+#include "jobhandle.h"
+
+// Coroutine jobs need the C++20 coroutine support, the rest of the library still builds without it
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define JOBSYSTEM_HAS_COROUTINES 1
+
+class CoroutineJob;
+
+// What CoroutineJob::Run() returns. The coroutine starts suspended, the job takes it over and starts it
+class JobTask
+{
+public:
+    struct FinalAwaiter;
+
+    struct promise_type
+    {
+        CoroutineJob *m_job = nullptr;
+
+        JobTask get_return_object() { return JobTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception();
+    };
+
+    // Completes the job once the coroutine has run to the end. The frame stays alive until the job is deleted
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept;
+        void await_resume() noexcept {}
+    };
+
+    JobTask(JobTask &&other) noexcept : m_coroutine(other.m_coroutine) { other.m_coroutine = nullptr; }
+    JobTask(const JobTask &) = delete;
+    JobTask &operator=(const JobTask &) = delete;
+    ~JobTask();
+
+    std::coroutine_handle<promise_type> Release();
+
+private:
+    explicit JobTask(std::coroutine_handle<promise_type> coroutine) : m_coroutine(coroutine) {}
+
+    std::coroutine_handle<promise_type> m_coroutine;
+};
+
+// A job whose body is a coroutine. Run() may co_await another job's handle, a subprocess or a delay
+// without holding a worker: the job stays running while it is suspended and each resumption is posted
+// back onto a worker serving the job's channels. The job completes when Run() returns.
+// Cancelling terminates the subprocess being awaited, and later JobProcess and JobDelay awaits
+// return at once, with a spawn error for the former, so Run() winds down on its own
+class CoroutineJob : public Job
+{
+    friend class JobTask;
+
+public:
+    CoroutineJob(unsigned long jobChannels = JOB_CHANNEL_CPU) : Job(jobChannels) {}
+    virtual ~CoroutineJob();
+
+    void Execute() override final;
+
+protected:
+    virtual JobTask Run() = 0;
+
+private:
+    // Called by awaiters once what they waited on has happened, the coroutine continues on a worker
+    void ResumeOnWorker();
+    void OnUnhandledException(const std::string &reason);
+    void OnCancel() override;
+
+    std::coroutine_handle<JobTask::promise_type> m_coroutine;
+    // Child of the JobProcess being awaited, -1 while there is none
+    std::atomic<pid_t> m_awaitedProcessID{-1};
+
+    friend struct JobHandleAwaiter;
+    friend struct JobProcess;
+    friend struct JobDelay;
+};
+
+// co_await on a JobHandle, resumes with the job's output once it completes. The job must be queued
+// by someone, awaiting one that never runs suspends forever
+struct JobHandleAwaiter
+{
+    JobHandle m_jobHandle;
+
+    bool await_ready() const { return m_jobHandle.IsComplete(); }
+    void await_suspend(std::coroutine_handle<JobTask::promise_type> coroutine);
+    Job::Payload await_resume() const;
+};
+
+inline JobHandleAwaiter operator co_await(const JobHandle &jobHandle)
+{
+    return JobHandleAwaiter{jobHandle};
+}
+
+// Result of co_await JobProcess, the exit code is -1 and spawnError is set if the child never started
+struct JobProcessResult
+{
+    int m_exitCode = -1;
+    std::string m_output;
+    std::string m_spawnError;
+    // Spawned until exited, zero if it never started
+    std::chrono::steady_clock::duration m_runningTime{0};
+};
+
+// co_await JobProcess("command") runs the command through the job system's reactor, the same way a
+// ProcessJob does, and resumes with its exit code and output once it has exited
+struct JobProcess
+{
+    explicit JobProcess(std::string command) : m_command(std::move(command)) {}
+
+    bool await_ready() const { return false; }
+    bool await_suspend(std::coroutine_handle<JobTask::promise_type> coroutine);
+    JobProcessResult await_resume() { return std::move(m_result); }
+
+    std::string m_command;
+    JobProcessResult m_result;
+};
+
+// co_await JobDelay(duration) resumes on a worker once the duration has passed, on a reactor timer
+struct JobDelay
+{
+    explicit JobDelay(std::chrono::steady_clock::duration delay) : m_delay(delay) {}
+
+    bool await_ready() const { return m_delay <= std::chrono::steady_clock::duration::zero(); }
+    bool await_suspend(std::coroutine_handle<JobTask::promise_type> coroutine);
+    void await_resume() const {}
+
+    std::chrono::steady_clock::duration m_delay;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "job.h"
+#include "jobsystem.h"
+
+void Job::DeferCompletion()
+{
+    m_deferredCompletion.store(DEFERRED_COMPLETION_PENDING);
+}
+
+void Job::CompleteDeferred()
+{
+    // If the worker is still inside Execute() it completes the job when it returns, otherwise we do it here
+    if (m_deferredCompletion.exchange(DEFERRED_COMPLETION_REQUESTED) == DEFERRED_COMPLETION_PARKED)
+    {
+        m_jobSystem->OnJobCompleted(this);
+    }
+}
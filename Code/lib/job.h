@@ -2,25 +2,80 @@
 #include <mutex>
 #include <map>
 #include <deque>
+#include <list>
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <algorithm>
 #include <nlohmann/json.hpp>
+#include "jobhandle.h"
+#include "joballocator.h"
+#include "jobtrace.h"
+#include "jobmutex.h"
+
+class Job;
+using JobList = std::list<Job *, JobPoolAllocator<Job *>>;
+
+// Channels the default worker pools serve. CPU work runs on a fixed pool sized to the cores,
+// jobs that spend their time blocked on subprocesses or files go to the elastic I/O pool
+constexpr unsigned long JOB_CHANNEL_CPU = 1UL << 0;
+constexpr unsigned long JOB_CHANNEL_IO = 1UL << 1;
+constexpr unsigned long JOB_CHANNEL_ALL = 0xFFFFFFFF;
+
+// Higher priorities are claimed first. Waiting jobs age, so a low priority job is not starved by a
+// steady stream of higher priority work
+enum JobPriority
+{
+    JOB_PRIORITY_LOW = 0,
+    JOB_PRIORITY_NORMAL,
+    JOB_PRIORITY_HIGH,
+    JOB_PRIORITY_CRITICAL,
+};
+
+// How the job system re-runs a job that completes with a non-zero exit code. Only the failed job runs
+// again, after a backoff that starts at m_initialBackoff, grows by m_backoffMultiplier per attempt up to
+// m_maxBackoff, and is spread by up to m_jitter either way so retries of many jobs do not line up.
+// An empty m_retryableExitCodes retries any failure. Cancelled and timed out jobs are never retried
+struct JobRetryPolicy
+{
+    int m_maxAttempts = 1;
+    std::chrono::milliseconds m_initialBackoff{500};
+    double m_backoffMultiplier = 2.0;
+    std::chrono::milliseconds m_maxBackoff{30000};
+    double m_jitter = 0.2;
+    std::vector<int> m_retryableExitCodes;
+
+    bool IsRetryable(int exitCode) const
+    {
+        return (exitCode != 0) && (m_retryableExitCodes.empty() ||
+                                   (std::find(m_retryableExitCodes.begin(), m_retryableExitCodes.end(), exitCode) != m_retryableExitCodes.end()));
+    }
+};
 
 class JobSystem;
+struct JobTypeMetrics;
 class Job
 {
     friend class JobSystem;
     friend class JobWorkerThread;
+    friend class JobWorkerQueue;
 
 public:
-    Job(unsigned long jobChannels = 0xFFFFFFF, int jobType = -1) : m_jobChannels(jobChannels), m_jobType(jobType)
+    // The job gets its ID from the job system that creates it
+    Job(unsigned long jobChannels = JOB_CHANNEL_CPU, int jobType = -1) : m_jobChannels(jobChannels), m_jobType(jobType),
+                                                                   m_completionState(std::allocate_shared<JobCompletionState>(JobPoolAllocator<JobCompletionState>()))
     {
-        static int s_nextJobID = 0;
-        m_jobID = s_nextJobID++;
+        m_timeline.m_createdTime = JobTimeline::Now();
     }
 
     virtual ~Job() {}
 
+    // Every job, including the ones made by registered factories, comes from the job pool
+    static void *operator new(size_t size) { return JobAllocator::Allocate(size); }
+    static void operator delete(void *block, size_t size) { JobAllocator::Free(block, size); }
+
     // Must inherit Execute() function because it has no body
     virtual void Execute() = 0;
     // virtual nlohmann::json Execute(const nlohmann::json &input) = 0;
@@ -33,56 +88,209 @@ public:
     // Set job Name
     void SetJobName(const std::string &jobName)
     {
-        std::lock_guard<std::mutex> lockName(m_jobNameMutex);
+        std::lock_guard<JobMutex> lockName(m_jobNameMutex);
         m_jobName = jobName;
     }
 
+    // The graph run the job's name belongs to
+    JobRunID GetRunID() const
+    {
+        return m_runID;
+    }
+
+    // Inputs and outputs are shared immutable payloads, handing one job's output to its dependents
+    // shares the same tree instead of copying it. Getters return the payload itself, so a reader
+    // keeps it alive even if the job swaps in a new one.
+    using Payload = std::shared_ptr<const nlohmann::json>;
+
     // Set input for the job
     void SetInput(const nlohmann::json &input)
     {
-        std::lock_guard<std::mutex> lockInput(m_inputMutex);
-        m_input = input;
+        SetInput(MakePayload(nlohmann::json(input)));
+    }
+
+    void SetInput(nlohmann::json &&input)
+    {
+        SetInput(MakePayload(std::move(input)));
+    }
+
+    void SetInput(Payload input)
+    {
+        std::lock_guard<JobMutex> lockPayload(m_payloadMutex);
+        m_input = input ? std::move(input) : GetEmptyPayload();
     }
 
     // Get input for a job
-    const nlohmann::json &GetInput() const
+    Payload GetInput() const
     {
-        std::lock_guard<std::mutex> lockInput(m_inputMutex);
+        std::lock_guard<JobMutex> lockPayload(m_payloadMutex);
         return m_input;
     }
 
     // Set output for the job
     void SetOutput(const nlohmann::json &output)
     {
-        std::lock_guard<std::mutex> lockOutput(m_outputMutex);
-        m_output = output;
+        SetOutput(MakePayload(nlohmann::json(output)));
+    }
+
+    void SetOutput(nlohmann::json &&output)
+    {
+        SetOutput(MakePayload(std::move(output)));
+    }
+
+    void SetOutput(Payload output)
+    {
+        std::lock_guard<JobMutex> lockPayload(m_payloadMutex);
+        m_output = output ? std::move(output) : GetEmptyPayload();
     }
 
     // Get output for a job
-    const nlohmann::json &GetOutput() const
+    Payload GetOutput() const
     {
-        std::lock_guard<std::mutex> lockOutput(m_outputMutex);
+        std::lock_guard<JobMutex> lockPayload(m_payloadMutex);
         return m_output;
     }
 
+    static Payload MakePayload(nlohmann::json &&payload)
+    {
+        return std::allocate_shared<const nlohmann::json>(JobPoolAllocator<nlohmann::json>(), std::move(payload));
+    }
+
+    // Shared null payload, so jobs without input or output never hand out a null pointer
+    static const Payload &GetEmptyPayload()
+    {
+        static const Payload s_emptyPayload = std::make_shared<const nlohmann::json>();
+        return s_emptyPayload;
+    }
+
+    // Which workers may run the job, a worker takes it if any of their channels overlap
+    void SetJobChannels(unsigned long jobChannels) { m_jobChannels = jobChannels; }
+    unsigned long GetJobChannels() const { return m_jobChannels; }
+
+    // Scheduling hints, only read when the job is released onto a ready queue
+    void SetPriority(int priority)
+    {
+        m_priority = std::max((int)JOB_PRIORITY_LOW, std::min(priority, (int)JOB_PRIORITY_CRITICAL));
+    }
+
+    int GetPriority() const { return m_priority; }
+
+    void SetDeadline(std::chrono::steady_clock::time_point deadline)
+    {
+        m_deadline = deadline;
+    }
+
+    bool HasDeadline() const { return m_deadline != std::chrono::steady_clock::time_point::max(); }
+
+    // The job is cancelled if it is still running this long after a worker claimed it, zero never times out
+    void SetTimeout(std::chrono::milliseconds timeout) { m_timeout = timeout; }
+    std::chrono::milliseconds GetTimeout() const { return m_timeout; }
+
+    // Set by JobSystem::CancelJob(). A job cancelled before it runs completes without running,
+    // a running one is told through OnCancel() and may also poll this
+    bool IsCancelled() const { return m_isCancelled.load(); }
+
+    void SetRetryPolicy(const JobRetryPolicy &retryPolicy) { m_retryPolicy = retryPolicy; }
+    const JobRetryPolicy &GetRetryPolicy() const { return m_retryPolicy; }
+    // Starts at 1 and goes up each time the job is retried
+    int GetAttempt() const { return m_attempt.load(); }
+    // Zero unless the last attempt failed, see SetExitCode()
+    int GetExitCode() const { return m_exitCode; }
+
     // Do not have to implement JobCompleteCallback() because it has a body
     virtual void JobCompleteCallback(){};
     // Forcing the function, job type will be returned as a const
-    int GetUniqueID() const { return m_jobID; }
+    JobID GetUniqueID() const { return m_jobID; }
     // Queuing dependent jobs, if a job has one
     virtual void EnqueueNextJob(JobSystem *js){};
 
+protected:
+    // Job system that created the job, nullptr until CreateJob or SubmitGraph hands it out
+    JobSystem *GetJobSystem() const { return m_jobSystem; }
+
+    // Called from Execute() by jobs that finish later on another thread, e.g. when a subprocess exits.
+    // The job stays running after Execute() returns, until CompleteDeferred() is called exactly once
+    void DeferCompletion();
+    void CompleteDeferred();
+
+    // Non-zero marks the attempt as failed, which the retry policy may act on. Set from Execute() or
+    // before CompleteDeferred(), subprocess jobs set it to the child's exit code
+    void SetExitCode(int exitCode) { m_exitCode = exitCode; }
+
+    // Called once on the cancelling thread, the job may be running or still waiting to run. Jobs that
+    // wait on something outside the process stop it here; the job still completes the usual way
+    virtual void OnCancel() {}
+
+private:
+    // Deferred completion handshake between the worker returning from Execute() and CompleteDeferred()
+    enum DeferredCompletionState
+    {
+        DEFERRED_COMPLETION_NONE,
+        DEFERRED_COMPLETION_PENDING,   // Execute() deferred and has not returned yet
+        DEFERRED_COMPLETION_PARKED,    // Execute() returned, waiting for CompleteDeferred()
+        DEFERRED_COMPLETION_REQUESTED, // CompleteDeferred() was called before Execute() returned
+    };
+
+    JobSystem *m_jobSystem = nullptr;
+    std::atomic<int> m_deferredCompletion{DEFERRED_COMPLETION_NONE};
+    // Posted jobs nobody finishes, the job system deletes them as soon as they complete
+    bool m_isAutoRetired = false;
+    // Set once JobCompleteCallback() ran on a worker or the callback thread, so finishing skips it
+    bool m_hasRunCallback = false;
+
+    // Written under m_successorsMutex before the flag is raised
+    std::atomic<bool> m_isCancelled{false};
+    std::string m_cancelReason;
+    std::chrono::milliseconds m_timeout{0};
+
+    JobRetryPolicy m_retryPolicy;
+    std::atomic<int> m_attempt{1};
+    int m_exitCode = 0;
+
 private:
-    int m_jobID = -1;
+    JobID m_jobID = INVALID_JOB_ID;
     int m_jobType = -1;
 
     std::string m_jobName;
-    mutable std::mutex m_jobNameMutex;
+    mutable JobMutex m_jobNameMutex{"Job::m_jobNameMutex"};
+    JobRunID m_runID = DEFAULT_JOB_RUN_ID;
+    // Registered type the job was created as, for traces
+    std::string m_jobTypeName;
+    // Written by whichever thread moves the job to the next stage, see JobTimeline
+    JobTimeline m_timeline;
+    // Counters of the job's type, owned by the job system
+    JobTypeMetrics *m_typeMetrics = nullptr;
+
+    Payload m_input = GetEmptyPayload();
+    Payload m_output = GetEmptyPayload();
+    mutable JobMutex m_payloadMutex{"Job::m_payloadMutex"};
+
+    unsigned long m_jobChannels = JOB_CHANNEL_CPU;
+
+    int m_priority = JOB_PRIORITY_NORMAL;
+    std::chrono::steady_clock::time_point m_deadline = std::chrono::steady_clock::time_point::max();
+    // Ready queue ordering, set by the job system when the job is pushed
+    long long m_scheduleKey = 0;
+    unsigned long long m_readySequence = 0;
 
-    nlohmann::json m_input;
-    mutable std::mutex m_inputMutex;
-    nlohmann::json m_output;
-    mutable std::mutex m_outputMutex;
+    // Dependency graph, the job is released onto a ready queue when its pending count reaches zero.
+    // A job made by CreateJob starts at one, for the QueueJob call it is still waiting on
+    std::atomic<int> m_pendingDependencies{0};
+    std::atomic<bool> m_isQueued{false};
+    std::atomic<bool> m_isReleased{false};
+    std::vector<JobID> m_successorIDs;
+    bool m_hasCompleted = false;
+    mutable JobMutex m_successorsMutex{"Job::m_successorsMutex"};
+    // The job system's own reference, dropped when the job retires, plus one for every CancelJob()
+    // calling OnCancel() outside the successor lock. Whoever drops the last one deletes the job
+    std::atomic<int> m_numReferences{1};
 
-    unsigned long m_jobChannels = 0xFFFFFFFF;
+    // Signalled when the job completes, shared with every JobHandle to this job
+    std::shared_ptr<JobCompletionState> m_completionState;
+    // Position in the job system's running list while m_isRunning, so completing or retrying a job
+    // does not search for it. Both are guarded by the running list's mutex
+    JobList::iterator m_runningIter;
+    bool m_isRunning = false;
+    // Position in the job system's completed list, so finishing a job does not search for it
+    JobList::iterator m_completedIter;
 };
\ No newline at end of file
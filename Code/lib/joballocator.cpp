@@ -0,0 +1,138 @@
+#include "joballocator.h"
+#include <new>
+
+JobAllocator::ThreadCache::~ThreadCache()
+{
+    // Hand everything back so other threads can reuse it after this one exits
+    for (size_t sizeClass = 0; sizeClass < NUM_SIZE_CLASSES; ++sizeClass)
+    {
+        DrainThreadCache(*this, sizeClass, m_numFreeBlocks[sizeClass]);
+    }
+}
+
+JobAllocator::SharedPool &JobAllocator::GetSharedPool()
+{
+    // Leaked on purpose, a static destructor would free the slabs under blocks still in use
+    static SharedPool *s_sharedPool = new SharedPool();
+    return *s_sharedPool;
+}
+
+JobAllocator::ThreadCache &JobAllocator::GetThreadCache()
+{
+    static thread_local ThreadCache t_threadCache;
+    return t_threadCache;
+}
+
+void *JobAllocator::Allocate(size_t size)
+{
+    size_t sizeClass = (size == 0) ? 0 : (size - 1) / BLOCK_GRANULARITY;
+    if (sizeClass >= NUM_SIZE_CLASSES)
+    {
+        return ::operator new(size);
+    }
+
+    ThreadCache &threadCache = GetThreadCache();
+    if (threadCache.m_freeBlocks[sizeClass] == nullptr)
+    {
+        RefillThreadCache(threadCache, sizeClass);
+    }
+
+    FreeBlock *block = threadCache.m_freeBlocks[sizeClass];
+    threadCache.m_freeBlocks[sizeClass] = block->m_next;
+    threadCache.m_numFreeBlocks[sizeClass]--;
+    return block;
+}
+
+void JobAllocator::Free(void *block, size_t size)
+{
+    if (block == nullptr)
+    {
+        return;
+    }
+
+    size_t sizeClass = (size == 0) ? 0 : (size - 1) / BLOCK_GRANULARITY;
+    if (sizeClass >= NUM_SIZE_CLASSES)
+    {
+        ::operator delete(block);
+        return;
+    }
+
+    ThreadCache &threadCache = GetThreadCache();
+    FreeBlock *freeBlock = static_cast<FreeBlock *>(block);
+    freeBlock->m_next = threadCache.m_freeBlocks[sizeClass];
+    threadCache.m_freeBlocks[sizeClass] = freeBlock;
+    threadCache.m_numFreeBlocks[sizeClass]++;
+
+    // Jobs are often created on one thread and retired on another, so caches that only
+    // receive frees give the surplus back to the shared list instead of growing forever
+    if (threadCache.m_numFreeBlocks[sizeClass] > MAX_CACHED_BLOCKS)
+    {
+        DrainThreadCache(threadCache, sizeClass, BLOCKS_PER_BATCH);
+    }
+}
+
+size_t JobAllocator::GetNumSlabs()
+{
+    SharedPool &sharedPool = GetSharedPool();
+    std::lock_guard<std::mutex> lock(sharedPool.m_slabsMutex);
+    return sharedPool.m_slabs.size();
+}
+
+void JobAllocator::RefillThreadCache(ThreadCache &threadCache, size_t sizeClass)
+{
+    SharedPool &sharedPool = GetSharedPool();
+    SizeClass &sharedClass = sharedPool.m_sizeClasses[sizeClass];
+
+    // Take a batch from the shared list first
+    {
+        std::lock_guard<std::mutex> lock(sharedClass.m_mutex);
+        for (size_t i = 0; (i < BLOCKS_PER_BATCH) && (sharedClass.m_freeBlocks != nullptr); ++i)
+        {
+            FreeBlock *block = sharedClass.m_freeBlocks;
+            sharedClass.m_freeBlocks = block->m_next;
+            block->m_next = threadCache.m_freeBlocks[sizeClass];
+            threadCache.m_freeBlocks[sizeClass] = block;
+            threadCache.m_numFreeBlocks[sizeClass]++;
+        }
+    }
+
+    if (threadCache.m_freeBlocks[sizeClass] != nullptr)
+    {
+        return;
+    }
+
+    // Nothing shared either, carve a new slab into a batch of blocks
+    size_t blockSize = (sizeClass + 1) * BLOCK_GRANULARITY;
+    char *slab = static_cast<char *>(::operator new(blockSize * BLOCKS_PER_BATCH));
+    {
+        std::lock_guard<std::mutex> lock(sharedPool.m_slabsMutex);
+        sharedPool.m_slabs.push_back(slab);
+    }
+
+    for (size_t i = 0; i < BLOCKS_PER_BATCH; ++i)
+    {
+        FreeBlock *block = reinterpret_cast<FreeBlock *>(slab + i * blockSize);
+        block->m_next = threadCache.m_freeBlocks[sizeClass];
+        threadCache.m_freeBlocks[sizeClass] = block;
+        threadCache.m_numFreeBlocks[sizeClass]++;
+    }
+}
+
+void JobAllocator::DrainThreadCache(ThreadCache &threadCache, size_t sizeClass, size_t numBlocks)
+{
+    if (numBlocks == 0)
+    {
+        return;
+    }
+
+    SizeClass &sharedClass = GetSharedPool().m_sizeClasses[sizeClass];
+    std::lock_guard<std::mutex> lock(sharedClass.m_mutex);
+    for (size_t i = 0; (i < numBlocks) && (threadCache.m_freeBlocks[sizeClass] != nullptr); ++i)
+    {
+        FreeBlock *block = threadCache.m_freeBlocks[sizeClass];
+        threadCache.m_freeBlocks[sizeClass] = block->m_next;
+        threadCache.m_numFreeBlocks[sizeClass]--;
+        block->m_next = sharedClass.m_freeBlocks;
+        sharedClass.m_freeBlocks = block;
+    }
+}
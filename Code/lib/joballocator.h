@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Size class pool for jobs and the small objects the job system allocates for every job.
+// Each thread caches free blocks per size class, so creating and retiring jobs at a high rate
+// stays off the global allocator; blocks move to a shared list in batches when a cache overflows.
+class JobAllocator
+{
+public:
+    static void *Allocate(size_t size);
+    static void Free(void *block, size_t size);
+
+    // Number of slabs taken from the global allocator so far
+    static size_t GetNumSlabs();
+
+private:
+    static constexpr size_t BLOCK_GRANULARITY = 64;
+    static constexpr size_t NUM_SIZE_CLASSES = 16;
+    static constexpr size_t BLOCKS_PER_BATCH = 32;
+    static constexpr size_t MAX_CACHED_BLOCKS = 4 * BLOCKS_PER_BATCH;
+
+    struct FreeBlock
+    {
+        FreeBlock *m_next = nullptr;
+    };
+
+    struct SizeClass
+    {
+        FreeBlock *m_freeBlocks = nullptr;
+        std::mutex m_mutex;
+    };
+
+    struct ThreadCache
+    {
+        ~ThreadCache();
+
+        FreeBlock *m_freeBlocks[NUM_SIZE_CLASSES] = {};
+        size_t m_numFreeBlocks[NUM_SIZE_CLASSES] = {};
+    };
+
+    // Never destroyed, jobs freed during static teardown or by a thread exiting late still find it.
+    // Its slabs are handed back to the system with the process
+    struct SharedPool
+    {
+        SizeClass m_sizeClasses[NUM_SIZE_CLASSES];
+        std::vector<void *> m_slabs;
+        std::mutex m_slabsMutex;
+    };
+
+    static SharedPool &GetSharedPool();
+    static ThreadCache &GetThreadCache();
+    static void RefillThreadCache(ThreadCache &threadCache, size_t sizeClass);
+    static void DrainThreadCache(ThreadCache &threadCache, size_t sizeClass, size_t numBlocks);
+};
+
+// Standard allocator on top of JobAllocator, for containers and shared state owned by jobs
+template <class T>
+class JobPoolAllocator
+{
+public:
+    using value_type = T;
+
+    JobPoolAllocator() = default;
+    template <class U>
+    JobPoolAllocator(const JobPoolAllocator<U> &) {}
+
+    T *allocate(size_t count) { return static_cast<T *>(JobAllocator::Allocate(count * sizeof(T))); }
+    void deallocate(T *block, size_t count) { JobAllocator::Free(block, count * sizeof(T)); }
+
+    template <class U>
+    bool operator==(const JobPoolAllocator<U> &) const { return true; }
+    template <class U>
+    bool operator!=(const JobPoolAllocator<U> &) const { return false; }
+};
@@ -0,0 +1,91 @@
+#include "jobhandle.h"
+
+JobHandle::JobHandle(JobID jobID, std::shared_ptr<JobCompletionState> completionState) : m_jobID(jobID),
+                                                                                        m_completionState(completionState)
+{
+}
+
+bool JobHandle::IsComplete() const
+{
+    if (!m_completionState)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_completionState->m_mutex);
+    return m_completionState->m_isCompleted;
+}
+
+void JobHandle::Wait() const
+{
+    if (!m_completionState)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_completionState->m_mutex);
+    m_completionState->m_completedCondition.wait(lock, [this]()
+                                                  { return m_completionState->m_isCompleted; });
+}
+
+bool JobHandle::WaitFor(std::chrono::milliseconds timeout) const
+{
+    if (!m_completionState)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_completionState->m_mutex);
+    return m_completionState->m_completedCondition.wait_for(lock, timeout, [this]()
+                                                            { return m_completionState->m_isCompleted; });
+}
+
+std::shared_ptr<const nlohmann::json> JobHandle::GetOutput() const
+{
+    if (!m_completionState)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_completionState->m_mutex);
+    return m_completionState->m_isCompleted ? m_completionState->m_output : nullptr;
+}
+
+JobHandle &JobHandle::Then(std::function<void(const nlohmann::json &output)> continuation)
+{
+    if (!m_completionState)
+    {
+        return *this;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_completionState->m_mutex);
+        if (!m_completionState->m_isCompleted)
+        {
+            m_completionState->m_continuations.push_back(continuation);
+            return *this;
+        }
+    }
+
+    // Already complete, the output no longer changes so it is safe to read without the lock
+    continuation(*m_completionState->m_output);
+    return *this;
+}
+
+void JobHandle::SignalCompleted(const std::shared_ptr<JobCompletionState> &completionState, std::shared_ptr<const nlohmann::json> output)
+{
+    std::vector<std::function<void(const nlohmann::json &)>> continuations;
+    {
+        std::lock_guard<std::mutex> lock(completionState->m_mutex);
+        completionState->m_output = std::move(output);
+        completionState->m_isCompleted = true;
+        continuations.swap(completionState->m_continuations);
+    }
+
+    // Wake every waiter, then run the continuations outside the lock
+    completionState->m_completedCondition.notify_all();
+    for (auto &continuation : continuations)
+    {
+        continuation(*completionState->m_output);
+    }
+}
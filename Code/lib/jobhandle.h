@@ -0,0 +1,49 @@
+#pragma once
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <nlohmann/json.hpp>
+#include "jobid.h"
+
+// Completion event shared by a job and every handle to it, outlives the job itself
+struct JobCompletionState
+{
+    bool m_isCompleted = false;
+    std::shared_ptr<const nlohmann::json> m_output;
+    std::vector<std::function<void(const nlohmann::json &)>> m_continuations;
+    std::mutex m_mutex;
+    std::condition_variable m_completedCondition;
+};
+
+class JobHandle
+{
+    friend class JobSystem;
+
+public:
+    JobHandle() = default;
+    JobHandle(JobID jobID, std::shared_ptr<JobCompletionState> completionState);
+
+    JobID GetJobID() const { return m_jobID; }
+    bool IsValid() const { return m_completionState != nullptr; }
+    bool IsComplete() const;
+
+    // Block until the job completes, WaitFor() returns false if the timeout ran out first
+    void Wait() const;
+    bool WaitFor(std::chrono::milliseconds timeout) const;
+
+    // The job's output once it has completed, nullptr before that
+    std::shared_ptr<const nlohmann::json> GetOutput() const;
+
+    // Run a continuation with the job's output once it completes, on the worker that completed it,
+    // or right away on the calling thread if the job is already complete
+    JobHandle &Then(std::function<void(const nlohmann::json &output)> continuation);
+
+private:
+    static void SignalCompleted(const std::shared_ptr<JobCompletionState> &completionState, std::shared_ptr<const nlohmann::json> output);
+
+    JobID m_jobID = INVALID_JOB_ID;
+    std::shared_ptr<JobCompletionState> m_completionState;
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+
+// Job IDs are 64-bit and handed out by each JobSystem instance from its own counter,
+// so two job systems in one process can hand out the same ID for different jobs
+using JobID = std::int64_t;
+constexpr JobID INVALID_JOB_ID = -1;
+
+// Graph runs scope job names, the same name can be used by any number of runs at once.
+// Jobs created without a run share the default run, where a name maps to its latest job
+using JobRunID = std::int64_t;
+constexpr JobRunID DEFAULT_JOB_RUN_ID = 0;
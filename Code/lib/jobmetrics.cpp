@@ -0,0 +1,105 @@
+#include "jobmetrics.h"
+#include <bit>
+#include <algorithm>
+
+void JobLatencyHistogram::Record(std::chrono::steady_clock::duration latency)
+{
+    long long latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    unsigned long long sampleUs = (latencyUs > 0) ? (unsigned long long)latencyUs : 0;
+
+    int bucket = std::min(NUM_BUCKETS - 1, (int)std::bit_width(sampleUs));
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_totalUs.fetch_add(sampleUs, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+unsigned long long JobLatencyHistogram::GetPercentileUs(unsigned long long count, double percentile) const
+{
+    unsigned long long rank = (unsigned long long)(percentile * (double)count);
+    unsigned long long seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+    {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen > rank)
+        {
+            return 1ULL << i;
+        }
+    }
+    return 1ULL << (NUM_BUCKETS - 1);
+}
+
+nlohmann::json JobLatencyHistogram::ToJson() const
+{
+    nlohmann::json histogram;
+    unsigned long long count = m_count.load(std::memory_order_relaxed);
+    histogram["count"] = count;
+    if (count == 0)
+    {
+        return histogram;
+    }
+
+    histogram["meanUs"] = (double)m_totalUs.load(std::memory_order_relaxed) / (double)count;
+    histogram["p50Us"] = GetPercentileUs(count, 0.50);
+    histogram["p90Us"] = GetPercentileUs(count, 0.90);
+    histogram["p99Us"] = GetPercentileUs(count, 0.99);
+
+    // Only the buckets anything fell into, each with its upper bound
+    nlohmann::json buckets = nlohmann::json::array();
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+    {
+        unsigned long long bucketCount = m_buckets[i].load(std::memory_order_relaxed);
+        if (bucketCount == 0)
+        {
+            continue;
+        }
+
+        nlohmann::json bucket;
+        bucket["belowUs"] = 1ULL << i;
+        bucket["count"] = bucketCount;
+        buckets.push_back(std::move(bucket));
+    }
+    histogram["buckets"] = std::move(buckets);
+    return histogram;
+}
+
+void JobTypeMetrics::RecordAttempt(const JobTimeline &timeline, bool isRetried, bool isCancelled, int exitCode)
+{
+    // A job cancelled while it waited was never released or claimed
+    if (JobTimeline::IsSet(timeline.m_releasedTime) && JobTimeline::IsSet(timeline.m_claimedTime))
+    {
+        m_queueWait.Record(timeline.m_claimedTime - timeline.m_releasedTime);
+    }
+    if (JobTimeline::IsSet(timeline.m_claimedTime) && JobTimeline::IsSet(timeline.m_completedTime))
+    {
+        m_execution.Record(timeline.m_completedTime - timeline.m_claimedTime);
+    }
+
+    if (isRetried)
+    {
+        m_numRetried.fetch_add(1, std::memory_order_relaxed);
+    }
+    else if (isCancelled)
+    {
+        m_numCancelled.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_numCompleted.fetch_add(1, std::memory_order_relaxed);
+        if (exitCode != 0)
+        {
+            m_numFailed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+nlohmann::json JobTypeMetrics::ToJson() const
+{
+    nlohmann::json metrics;
+    metrics["completed"] = m_numCompleted.load(std::memory_order_relaxed);
+    metrics["cancelled"] = m_numCancelled.load(std::memory_order_relaxed);
+    metrics["failed"] = m_numFailed.load(std::memory_order_relaxed);
+    metrics["retried"] = m_numRetried.load(std::memory_order_relaxed);
+    metrics["queueWait"] = m_queueWait.ToJson();
+    metrics["execution"] = m_execution.ToJson();
+    return metrics;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <nlohmann/json.hpp>
+#include "jobtrace.h"
+
+// Latency histogram with power of two microsecond buckets, bucket i counts samples below 2^i us and
+// the last one everything above. Recording is a couple of relaxed atomic adds, so any number of
+// workers can record into one histogram without a lock
+class JobLatencyHistogram
+{
+public:
+    static constexpr int NUM_BUCKETS = 32;
+
+    void Record(std::chrono::steady_clock::duration latency);
+
+    // Count, mean, estimated percentiles and the non-empty buckets. Read while workers record, so
+    // the numbers can be a few samples apart from each other
+    nlohmann::json ToJson() const;
+
+private:
+    // Upper bound of the bucket the rank falls in, in microseconds
+    unsigned long long GetPercentileUs(unsigned long long count, double percentile) const;
+
+    std::atomic<unsigned long long> m_buckets[NUM_BUCKETS] = {};
+    std::atomic<unsigned long long> m_count{0};
+    std::atomic<unsigned long long> m_totalUs{0};
+};
+
+// Counters for one registered job type. Created when the type is registered and never removed,
+// jobs keep a pointer to theirs so completing a job needs no lookup
+struct JobTypeMetrics
+{
+    std::atomic<unsigned long long> m_numCompleted{0};
+    std::atomic<unsigned long long> m_numCancelled{0};
+    // Completed with a non-zero exit code on their last attempt
+    std::atomic<unsigned long long> m_numFailed{0};
+    // Failed attempts that were run again
+    std::atomic<unsigned long long> m_numRetried{0};
+
+    // Released onto a ready queue until a worker claimed it
+    JobLatencyHistogram m_queueWait;
+    // Claimed until completed, which includes the wait of jobs that defer their completion
+    JobLatencyHistogram m_execution;
+
+    void RecordAttempt(const JobTimeline &timeline, bool isRetried, bool isCancelled, int exitCode);
+    nlohmann::json ToJson() const;
+};
@@ -0,0 +1,154 @@
+#include "jobmutex.h"
+
+#ifdef JOBSYSTEM_PROFILE_LOCKS
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Stats live for the whole process, locks come and go with their jobs and job systems
+struct JobLockRegistry
+{
+    std::map<std::string, std::unique_ptr<JobLockStats>> m_stats;
+    std::mutex m_mutex;
+};
+
+static JobLockRegistry &GetLockRegistry()
+{
+    static JobLockRegistry s_registry;
+    return s_registry;
+}
+
+static void UpdateMaximum(std::atomic<unsigned long long> &maximum, unsigned long long value)
+{
+    unsigned long long current = maximum.load(std::memory_order_relaxed);
+    while ((value > current) && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+static unsigned long long GetNanosecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+JobProfiledMutex::JobProfiledMutex(const char *lockName)
+{
+    JobLockRegistry &registry = GetLockRegistry();
+    std::lock_guard<std::mutex> lock(registry.m_mutex);
+    std::unique_ptr<JobLockStats> &stats = registry.m_stats[lockName];
+    if (!stats)
+    {
+        stats = std::make_unique<JobLockStats>();
+    }
+    m_stats = stats.get();
+}
+
+void JobProfiledMutex::lock()
+{
+    // Uncontended acquisitions cost one try, only a wait is timed
+    if (!m_mutex.try_lock())
+    {
+        std::chrono::steady_clock::time_point waitStartTime = std::chrono::steady_clock::now();
+        m_mutex.lock();
+        unsigned long long waitNanoseconds = GetNanosecondsSince(waitStartTime);
+
+        m_stats->m_numContended.fetch_add(1, std::memory_order_relaxed);
+        m_stats->m_waitNanoseconds.fetch_add(waitNanoseconds, std::memory_order_relaxed);
+        UpdateMaximum(m_stats->m_maxWaitNanoseconds, waitNanoseconds);
+    }
+
+    m_stats->m_numAcquisitions.fetch_add(1, std::memory_order_relaxed);
+    m_acquiredTime = std::chrono::steady_clock::now();
+}
+
+bool JobProfiledMutex::try_lock()
+{
+    if (!m_mutex.try_lock())
+    {
+        return false;
+    }
+
+    m_stats->m_numAcquisitions.fetch_add(1, std::memory_order_relaxed);
+    m_acquiredTime = std::chrono::steady_clock::now();
+    return true;
+}
+
+void JobProfiledMutex::unlock()
+{
+    unsigned long long holdNanoseconds = GetNanosecondsSince(m_acquiredTime);
+    m_mutex.unlock();
+
+    m_stats->m_holdNanoseconds.fetch_add(holdNanoseconds, std::memory_order_relaxed);
+    UpdateMaximum(m_stats->m_maxHoldNanoseconds, holdNanoseconds);
+}
+
+nlohmann::json JobLockProfiler::GetReport()
+{
+    nlohmann::json locks = nlohmann::json::array();
+    {
+        JobLockRegistry &registry = GetLockRegistry();
+        std::lock_guard<std::mutex> lock(registry.m_mutex);
+        for (const auto &lockStats : registry.m_stats)
+        {
+            const JobLockStats &stats = *lockStats.second;
+            unsigned long long numAcquisitions = stats.m_numAcquisitions.load(std::memory_order_relaxed);
+            unsigned long long numContended = stats.m_numContended.load(std::memory_order_relaxed);
+            double waitUs = stats.m_waitNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+            double holdUs = stats.m_holdNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+
+            nlohmann::json lockReport;
+            lockReport["name"] = lockStats.first;
+            lockReport["acquisitions"] = numAcquisitions;
+            lockReport["contended"] = numContended;
+            lockReport["contendedPercent"] = (numAcquisitions > 0) ? (100.0 * numContended) / numAcquisitions : 0.0;
+            lockReport["waitMs"] = waitUs / 1000.0;
+            lockReport["averageWaitUs"] = (numContended > 0) ? waitUs / numContended : 0.0;
+            lockReport["maxWaitUs"] = stats.m_maxWaitNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+            lockReport["holdMs"] = holdUs / 1000.0;
+            lockReport["averageHoldUs"] = (numAcquisitions > 0) ? holdUs / numAcquisitions : 0.0;
+            lockReport["maxHoldUs"] = stats.m_maxHoldNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+            locks.push_back(std::move(lockReport));
+        }
+    }
+
+    std::sort(locks.begin(), locks.end(), [](const nlohmann::json &lhs, const nlohmann::json &rhs)
+              { return lhs["waitMs"].get<double>() > rhs["waitMs"].get<double>(); });
+
+    nlohmann::json report;
+    report["enabled"] = true;
+    report["locks"] = std::move(locks);
+    return report;
+}
+
+void JobLockProfiler::Reset()
+{
+    JobLockRegistry &registry = GetLockRegistry();
+    std::lock_guard<std::mutex> lock(registry.m_mutex);
+    for (auto &lockStats : registry.m_stats)
+    {
+        JobLockStats &stats = *lockStats.second;
+        stats.m_numAcquisitions.store(0, std::memory_order_relaxed);
+        stats.m_numContended.store(0, std::memory_order_relaxed);
+        stats.m_waitNanoseconds.store(0, std::memory_order_relaxed);
+        stats.m_holdNanoseconds.store(0, std::memory_order_relaxed);
+        stats.m_maxWaitNanoseconds.store(0, std::memory_order_relaxed);
+        stats.m_maxHoldNanoseconds.store(0, std::memory_order_relaxed);
+    }
+}
+
+#else
+
+nlohmann::json JobLockProfiler::GetReport()
+{
+    nlohmann::json report;
+    report["enabled"] = false;
+    return report;
+}
+
+void JobLockProfiler::Reset()
+{
+}
+
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <nlohmann/json.hpp>
+
+// Mutex type of the scheduler's own locks. Building the library, and everything that includes its
+// headers, with -DJOBSYSTEM_PROFILE_LOCKS swaps in JobProfiledMutex, which records for each lock name
+// how often it was taken, how long threads waited for it and how long it was held. Every lock with
+// the same name, e.g. the successor lock of every job, adds up under that name.
+// Without the flag a JobMutex is a plain std::mutex and the name is dropped
+#ifdef JOBSYSTEM_PROFILE_LOCKS
+
+struct JobLockStats
+{
+    std::atomic<unsigned long long> m_numAcquisitions{0};
+    // Acquisitions that found the lock taken and had to wait
+    std::atomic<unsigned long long> m_numContended{0};
+    std::atomic<unsigned long long> m_waitNanoseconds{0};
+    std::atomic<unsigned long long> m_holdNanoseconds{0};
+    std::atomic<unsigned long long> m_maxWaitNanoseconds{0};
+    std::atomic<unsigned long long> m_maxHoldNanoseconds{0};
+};
+
+class JobProfiledMutex
+{
+public:
+    explicit JobProfiledMutex(const char *lockName);
+    JobProfiledMutex(const JobProfiledMutex &) = delete;
+    JobProfiledMutex &operator=(const JobProfiledMutex &) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+private:
+    std::mutex m_mutex;
+    JobLockStats *m_stats = nullptr;
+    // Only touched by the thread holding the lock
+    std::chrono::steady_clock::time_point m_acquiredTime;
+};
+
+using JobMutex = JobProfiledMutex;
+using JobConditionVariable = std::condition_variable_any;
+using JobWaitLock = std::unique_lock<JobProfiledMutex>;
+
+#else
+
+class JobMutex : public std::mutex
+{
+public:
+    explicit JobMutex(const char *) {}
+};
+
+using JobConditionVariable = std::condition_variable;
+// std::condition_variable only waits on a std::unique_lock<std::mutex>
+using JobWaitLock = std::unique_lock<std::mutex>;
+
+#endif
+
+class JobLockProfiler
+{
+public:
+    // Every lock name, the one threads spent the most time waiting for first.
+    // Only {"enabled": false} unless the library was built with JOBSYSTEM_PROFILE_LOCKS
+    static nlohmann::json GetReport();
+    // Zeroes the counters, e.g. to profile one phase of a run on its own
+    static void Reset();
+};
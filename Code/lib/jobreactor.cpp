@@ -0,0 +1,397 @@
+#include "jobreactor.h"
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+extern char **environ;
+
+// How often drained processes are checked for exit, a child can close its output before exiting
+static constexpr int REAP_POLL_INTERVAL_MS = 10;
+
+JobReactor::JobReactor()
+{
+    if (pipe(m_wakeFds) != 0)
+    {
+        std::cerr << "JobReactor: failed to create wake pipe" << std::endl;
+    }
+    for (int wakeFd : m_wakeFds)
+    {
+        fcntl(wakeFd, F_SETFL, fcntl(wakeFd, F_GETFL) | O_NONBLOCK);
+        fcntl(wakeFd, F_SETFD, FD_CLOEXEC);
+    }
+
+#ifdef __linux__
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event wakeEvent = {};
+    wakeEvent.events = EPOLLIN;
+    wakeEvent.data.fd = m_wakeFds[0];
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFds[0], &wakeEvent);
+#endif
+
+    m_thread = std::thread(&JobReactor::Run, this);
+}
+
+JobReactor::~JobReactor()
+{
+    m_isStopping.store(true);
+    Wake();
+    m_thread.join();
+
+    // Processes still running are left to finish on their own, we only stop listening to them
+    for (auto &processPair : m_processes)
+    {
+        close(processPair.first);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_newProcessesMutex);
+        for (auto &newProcess : m_newProcesses)
+        {
+            close(newProcess->m_outputFd);
+        }
+    }
+
+#ifdef __linux__
+    close(m_epollFd);
+#endif
+    close(m_wakeFds[0]);
+    close(m_wakeFds[1]);
+}
+
+void JobReactor::WatchProcess(pid_t processID, int outputFd, ProcessExitCallback onExit)
+{
+    fcntl(outputFd, F_SETFL, fcntl(outputFd, F_GETFL) | O_NONBLOCK);
+
+    std::unique_ptr<WatchedProcess> process = std::make_unique<WatchedProcess>();
+    process->m_processID = processID;
+    process->m_outputFd = outputFd;
+    process->m_onExit = std::move(onExit);
+    {
+        std::lock_guard<std::mutex> lock(m_newProcessesMutex);
+        m_newProcesses.push_back(std::move(process));
+    }
+    Wake();
+}
+
+pid_t JobReactor::SpawnProcess(const std::string &command, ProcessExitCallback onExit, std::string &spawnError,
+                               ProcessSpawnedCallback onSpawned)
+{
+    // One pipe for both stdout and stderr, like appending 2>&1 to the command. Both ends are
+    // close-on-exec from the start, a child spawned concurrently for another job must not inherit the
+    // write end or this job sees no EOF until that child exits too. The dup2 onto 1 and 2 clears it
+#ifdef __linux__
+    int outputPipe[2];
+    if (pipe2(outputPipe, O_CLOEXEC) != 0)
+    {
+        spawnError = std::string("pipe2 failed: ") + std::strerror(errno);
+        return -1;
+    }
+#else
+    // No pipe2 here, this narrows the window but cannot close it
+    int outputPipe[2];
+    if (pipe(outputPipe) != 0)
+    {
+        spawnError = std::string("pipe failed: ") + std::strerror(errno);
+        return -1;
+    }
+    fcntl(outputPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(outputPipe[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+    posix_spawn_file_actions_addclose(&fileActions, outputPipe[0]);
+    posix_spawn_file_actions_adddup2(&fileActions, outputPipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&fileActions, outputPipe[1], STDERR_FILENO);
+    posix_spawn_file_actions_addclose(&fileActions, outputPipe[1]);
+
+    posix_spawnattr_t spawnAttributes;
+    posix_spawnattr_init(&spawnAttributes);
+    posix_spawnattr_setflags(&spawnAttributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&spawnAttributes, 0);
+
+    pid_t processID = -1;
+    const char *shellArgs[] = {"sh", "-c", command.c_str(), nullptr};
+    int spawnResult = posix_spawn(&processID, "/bin/sh", &fileActions, &spawnAttributes, const_cast<char *const *>(shellArgs), environ);
+    posix_spawnattr_destroy(&spawnAttributes);
+    posix_spawn_file_actions_destroy(&fileActions);
+    close(outputPipe[1]);
+
+    if (spawnResult != 0)
+    {
+        close(outputPipe[0]);
+        spawnError = std::string("posix_spawn failed: ") + std::strerror(spawnResult);
+        return -1;
+    }
+
+    // Nothing reaps the child before it is watched, onExit cannot run before onSpawned has returned
+    bool isTerminating = (onSpawned != nullptr) && !onSpawned(processID);
+    WatchProcess(processID, outputPipe[0], std::move(onExit));
+    if (isTerminating)
+    {
+        TerminateProcess(processID);
+    }
+    return processID;
+}
+
+void JobReactor::AddTimer(std::chrono::steady_clock::time_point expiryTime, TimerCallback onExpired)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_timersMutex);
+        m_timers.emplace(expiryTime, std::move(onExpired));
+    }
+    Wake();
+}
+
+void JobReactor::TerminateProcess(pid_t processID, std::chrono::milliseconds killGracePeriod)
+{
+    AddTimer(std::chrono::steady_clock::now(), [this, processID, killGracePeriod]()
+             {
+                 if (!IsWatchingProcess(processID))
+                 {
+                     return;
+                 }
+                 kill(-processID, SIGTERM);
+
+                 AddTimer(std::chrono::steady_clock::now() + killGracePeriod, [this, processID]()
+                          {
+                              if (IsWatchingProcess(processID))
+                              {
+                                  kill(-processID, SIGKILL);
+                              }
+                          }); });
+}
+
+bool JobReactor::IsWatchingProcess(pid_t processID)
+{
+    // Reactor thread only, nothing is reaped while we look
+    for (const auto &processPair : m_processes)
+    {
+        if (processPair.second->m_processID == processID)
+        {
+            return true;
+        }
+    }
+    for (const auto &exitingProcess : m_exitingProcesses)
+    {
+        if (exitingProcess->m_processID == processID)
+        {
+            return true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_newProcessesMutex);
+    for (const auto &newProcess : m_newProcesses)
+    {
+        if (newProcess->m_processID == processID)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobReactor::Wake()
+{
+    char wakeByte = 1;
+    // A full pipe already guarantees a wakeup, so a failed write is fine
+    ssize_t written = write(m_wakeFds[1], &wakeByte, 1);
+    (void)written;
+}
+
+void JobReactor::Run()
+{
+    while (!m_isStopping.load())
+    {
+        AdoptNewProcesses();
+
+        WaitForEvents(GetWaitTimeoutMs());
+
+        ReapExitedProcesses();
+        FireExpiredTimers();
+    }
+}
+
+int JobReactor::GetWaitTimeoutMs()
+{
+    // Only poll on an interval while a drained child has yet to exit, otherwise sleep until the next timer
+    int timeoutMs = m_exitingProcesses.empty() ? -1 : REAP_POLL_INTERVAL_MS;
+
+    std::lock_guard<std::mutex> lock(m_timersMutex);
+    if (!m_timers.empty())
+    {
+        auto untilNextTimer = m_timers.begin()->first - std::chrono::steady_clock::now();
+        // Round up, waking a millisecond early would only spin
+        long long timerTimeoutMs = std::max(0LL, (long long)std::chrono::ceil<std::chrono::milliseconds>(untilNextTimer).count());
+        if ((timeoutMs < 0) || (timerTimeoutMs < timeoutMs))
+        {
+            timeoutMs = (int)std::min(timerTimeoutMs, (long long)INT_MAX);
+        }
+    }
+    return timeoutMs;
+}
+
+void JobReactor::FireExpiredTimers()
+{
+    std::vector<TimerCallback> expiredTimers;
+    {
+        std::lock_guard<std::mutex> lock(m_timersMutex);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        while (!m_timers.empty() && (m_timers.begin()->first <= now))
+        {
+            expiredTimers.push_back(std::move(m_timers.begin()->second));
+            m_timers.erase(m_timers.begin());
+        }
+    }
+
+    // Outside the lock, a callback may add another timer
+    for (TimerCallback &expiredTimer : expiredTimers)
+    {
+        expiredTimer();
+    }
+}
+
+void JobReactor::AdoptNewProcesses()
+{
+    std::vector<std::unique_ptr<WatchedProcess>> newProcesses;
+    {
+        std::lock_guard<std::mutex> lock(m_newProcessesMutex);
+        newProcesses.swap(m_newProcesses);
+    }
+
+    for (std::unique_ptr<WatchedProcess> &newProcess : newProcesses)
+    {
+        int outputFd = newProcess->m_outputFd;
+#ifdef __linux__
+        epoll_event processEvent = {};
+        processEvent.events = EPOLLIN;
+        processEvent.data.fd = outputFd;
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, outputFd, &processEvent);
+#endif
+        m_processes[outputFd] = std::move(newProcess);
+    }
+}
+
+void JobReactor::WaitForEvents(int timeoutMs)
+{
+    std::vector<int> readyFds;
+
+#ifdef __linux__
+    epoll_event events[64];
+    int numEvents = epoll_wait(m_epollFd, events, 64, timeoutMs);
+    for (int i = 0; i < numEvents; ++i)
+    {
+        readyFds.push_back(events[i].data.fd);
+    }
+#else
+    std::vector<pollfd> pollFds;
+    pollFds.push_back({m_wakeFds[0], POLLIN, 0});
+    for (auto &processPair : m_processes)
+    {
+        pollFds.push_back({processPair.first, POLLIN, 0});
+    }
+    if (poll(pollFds.data(), pollFds.size(), timeoutMs) > 0)
+    {
+        for (const pollfd &pollFd : pollFds)
+        {
+            if (pollFd.revents != 0)
+            {
+                readyFds.push_back(pollFd.fd);
+            }
+        }
+    }
+#endif
+
+    for (int readyFd : readyFds)
+    {
+        if (readyFd == m_wakeFds[0])
+        {
+            char wakeBytes[64];
+            while (read(m_wakeFds[0], wakeBytes, sizeof(wakeBytes)) > 0)
+            {
+            }
+            continue;
+        }
+
+        auto processIter = m_processes.find(readyFd);
+        if (processIter != m_processes.end())
+        {
+            DrainOutput(processIter->second.get());
+        }
+    }
+}
+
+void JobReactor::DrainOutput(WatchedProcess *process)
+{
+    char buffer[16384];
+    while (true)
+    {
+        ssize_t bytesRead = read(process->m_outputFd, buffer, sizeof(buffer));
+        if (bytesRead > 0)
+        {
+            process->m_output.append(buffer, bytesRead);
+            continue;
+        }
+        if ((bytesRead < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if ((bytesRead < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+        {
+            return;
+        }
+        break;
+    }
+
+    // End of output (or a broken pipe), stop listening and wait for the child to exit
+    int outputFd = process->m_outputFd;
+#ifdef __linux__
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, outputFd, nullptr);
+#endif
+    close(outputFd);
+    process->m_outputFd = -1;
+
+    auto processIter = m_processes.find(outputFd);
+    m_exitingProcesses.push_back(std::move(processIter->second));
+    m_processes.erase(processIter);
+}
+
+void JobReactor::ReapExitedProcesses()
+{
+    for (size_t i = 0; i < m_exitingProcesses.size();)
+    {
+        WatchedProcess *process = m_exitingProcesses[i].get();
+
+        int status = 0;
+        pid_t waitResult = waitpid(process->m_processID, &status, WNOHANG);
+        if (waitResult == 0)
+        {
+            ++i;
+            continue;
+        }
+
+        int exitCode = -1;
+        if (waitResult > 0)
+        {
+            exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : (WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1);
+        }
+
+        std::unique_ptr<WatchedProcess> exitedProcess = std::move(m_exitingProcesses[i]);
+        m_exitingProcesses[i] = std::move(m_exitingProcesses.back());
+        m_exitingProcesses.pop_back();
+
+        exitedProcess->m_onExit(exitedProcess->m_output, exitCode);
+    }
+}
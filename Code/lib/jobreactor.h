@@ -0,0 +1,87 @@
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <map>
+#include <chrono>
+#include <sys/types.h>
+
+// One background thread that waits on many child processes and timers at once. A watched process hands
+// over the read end of its output pipe, the reactor drains it as data arrives (epoll on Linux, poll elsewhere),
+// reaps the child once the pipe closes and calls back on the reactor thread with everything it wrote.
+// Callbacks should be short, they hold up every other process the reactor is watching.
+class JobReactor
+{
+public:
+    using ProcessExitCallback = std::function<void(const std::string &output, int exitCode)>;
+    using TimerCallback = std::function<void()>;
+    // Called with the child's process ID before the reactor watches it, so before onExit can run.
+    // Returning false terminates the child right away, e.g. when its job was cancelled while spawning
+    using ProcessSpawnedCallback = std::function<bool(pid_t processID)>;
+
+    JobReactor();
+    ~JobReactor();
+
+    // Takes ownership of outputFd. The exit code is the child's exit status, or 128 + the signal that killed it
+    void WatchProcess(pid_t processID, int outputFd, ProcessExitCallback onExit);
+
+    // Runs "/bin/sh -c command" with stdout and stderr on one pipe and watches it. The child leads its own
+    // process group, so terminating it takes whatever the shell started with it. Returns the child's
+    // process ID, or -1 with the reason in spawnError, in which case onExit is never called. The caller must
+    // not touch whatever onExit frees once this returns, hand it the process ID through onSpawned instead
+    pid_t SpawnProcess(const std::string &command, ProcessExitCallback onExit, std::string &spawnError,
+                       ProcessSpawnedCallback onSpawned = nullptr);
+
+    // Calls onExpired on the reactor thread once the time has come
+    void AddTimer(std::chrono::steady_clock::time_point expiryTime, TimerCallback onExpired);
+
+    // Sends SIGTERM to a spawned child's process group, then SIGKILL if it is still around after the grace
+    // period. Signals are sent from the reactor thread and only while the child is unreaped, so a recycled
+    // process ID is never hit. Its onExit still runs as usual once it is gone
+    void TerminateProcess(pid_t processID, std::chrono::milliseconds killGracePeriod = std::chrono::milliseconds(2000));
+
+private:
+    struct WatchedProcess
+    {
+        pid_t m_processID = -1;
+        int m_outputFd = -1;
+        std::string m_output;
+        ProcessExitCallback m_onExit;
+    };
+
+    void Run();
+    void Wake();
+    void AdoptNewProcesses();
+    void WaitForEvents(int timeoutMs);
+    void DrainOutput(WatchedProcess *process);
+    void ReapExitedProcesses();
+    void FireExpiredTimers();
+    bool IsWatchingProcess(pid_t processID);
+    int GetWaitTimeoutMs();
+
+    std::thread m_thread;
+    std::atomic<bool> m_isStopping{false};
+
+    // Writing a byte to the wake pipe interrupts the wait, used for new processes and shutdown
+    int m_wakeFds[2] = {-1, -1};
+#ifdef __linux__
+    int m_epollFd = -1;
+#endif
+
+    // Handed over by WatchProcess(), adopted by the reactor thread on its next pass
+    std::vector<std::unique_ptr<WatchedProcess>> m_newProcesses;
+    std::mutex m_newProcessesMutex;
+
+    // Timers by expiry time, any thread adds to them
+    std::multimap<std::chrono::steady_clock::time_point, TimerCallback> m_timers;
+    std::mutex m_timersMutex;
+
+    // Reactor thread only: processes with an open pipe by fd, and drained ones waiting for the child to exit
+    std::unordered_map<int, std::unique_ptr<WatchedProcess>> m_processes;
+    std::vector<std::unique_ptr<WatchedProcess>> m_exitingProcesses;
+};
@@ -0,0 +1,269 @@
+#include "jobstatustable.h"
+#include <iostream>
+#include <thread>
+
+JobStatusTable::JobStatusTable()
+{
+    for (int i = 0; i < MAX_SEGMENTS; ++i)
+    {
+        m_segments[i].store(nullptr);
+    }
+}
+
+JobStatusTable::~JobStatusTable()
+{
+    for (Segment *segment : m_allSegments)
+    {
+        delete segment;
+    }
+}
+
+JobStatus JobStatusTable::GetJobStatus(JobID jobID) const
+{
+    if (jobID < 0)
+    {
+        return JOB_STATUS_NEVER_SEEN;
+    }
+
+    // Anything below the lowest active index retired and had its segment recycled, or outlived it
+    if (jobID < m_lowestActiveIndex.load())
+    {
+        return GetLongLivedJobStatus(jobID);
+    }
+
+    JobID firstJobID = jobID - (jobID % SEGMENT_SIZE);
+    const Segment *segment = m_segments[(jobID / SEGMENT_SIZE) % MAX_SEGMENTS].load();
+    if ((segment == nullptr) || (segment->m_firstJobID.load() != firstJobID))
+    {
+        return (jobID < m_lowestActiveIndex.load()) ? GetLongLivedJobStatus(jobID) : JOB_STATUS_NEVER_SEEN;
+    }
+
+    JobStatus jobStatus = (JobStatus)segment->m_statuses[jobID % SEGMENT_SIZE].load();
+
+    // The segment may have been recycled or evicted while we read it
+    if (segment->m_firstJobID.load() != firstJobID)
+    {
+        return GetLongLivedJobStatus(jobID);
+    }
+
+    return jobStatus;
+}
+
+void JobStatusTable::SetJobStatus(JobID jobID, JobStatus jobStatus)
+{
+    if (jobID < 0)
+    {
+        return;
+    }
+
+    Segment *segment = GetOrCreateSegment(jobID);
+    if ((segment == nullptr) || !StoreJobStatus(segment, jobID, jobStatus))
+    {
+        SetLongLivedJobStatus(jobID, jobStatus);
+    }
+}
+
+void JobStatusTable::RetireJob(JobID jobID)
+{
+    if (jobID < 0)
+    {
+        return;
+    }
+
+    Segment *segment = GetOrCreateSegment(jobID);
+    if ((segment == nullptr) || !StoreJobStatus(segment, jobID, JOB_STATUS_RETIRED))
+    {
+        SetLongLivedJobStatus(jobID, JOB_STATUS_RETIRED);
+        return;
+    }
+
+    if (segment->m_numRetired.fetch_add(1) + 1 == SEGMENT_SIZE)
+    {
+        ReclaimRetiredSegments();
+    }
+}
+
+bool JobStatusTable::StoreJobStatus(Segment *segment, JobID jobID, JobStatus jobStatus)
+{
+    // Announced before the check, an eviction that invalidates the segment after it waits for the
+    // store, one that did so before it makes us go to the side table instead
+    segment->m_numWriters.fetch_add(1);
+    bool isHeld = (segment->m_firstJobID.load() == jobID - (jobID % SEGMENT_SIZE));
+    if (isHeld)
+    {
+        segment->m_statuses[jobID % SEGMENT_SIZE].store((unsigned char)jobStatus);
+    }
+    segment->m_numWriters.fetch_sub(1);
+    return isHeld;
+}
+
+void JobStatusTable::InvalidateSegment(Segment *segment)
+{
+    // A writer holds the segment for a single store, never while taking a lock
+    segment->m_firstJobID.store(INVALID_JOB_ID);
+    while (segment->m_numWriters.load() != 0)
+    {
+        std::this_thread::yield();
+    }
+}
+
+size_t JobStatusTable::GetNumSegments()
+{
+    std::lock_guard<std::mutex> lock(m_segmentsMutex);
+    return m_allSegments.size();
+}
+
+JobStatus JobStatusTable::GetLongLivedJobStatus(JobID jobID) const
+{
+    if (m_numLongLivedJobs.load() == 0)
+    {
+        return JOB_STATUS_RETIRED;
+    }
+
+    std::lock_guard<std::mutex> lock(m_longLivedJobsMutex);
+    auto jobIter = m_longLivedJobs.find(jobID);
+    return (jobIter != m_longLivedJobs.end()) ? jobIter->second : JOB_STATUS_RETIRED;
+}
+
+void JobStatusTable::SetLongLivedJobStatus(JobID jobID, JobStatus jobStatus)
+{
+    // Retiring is the last status a job gets, it is what every ID without an entry reads as
+    std::lock_guard<std::mutex> lock(m_longLivedJobsMutex);
+    if (jobStatus == JOB_STATUS_RETIRED)
+    {
+        m_longLivedJobs.erase(jobID);
+    }
+    else
+    {
+        m_longLivedJobs[jobID] = jobStatus;
+    }
+    m_numLongLivedJobs.store(m_longLivedJobs.size());
+}
+
+JobStatusTable::Segment *JobStatusTable::GetOrCreateSegment(JobID jobID)
+{
+    if (jobID < m_lowestActiveIndex.load())
+    {
+        return nullptr;
+    }
+
+    JobID firstJobID = jobID - (jobID % SEGMENT_SIZE);
+    std::atomic<Segment *> &segmentSlot = m_segments[(jobID / SEGMENT_SIZE) % MAX_SEGMENTS];
+
+    Segment *segment = segmentSlot.load();
+    if ((segment != nullptr) && (segment->m_firstJobID.load() == firstJobID))
+    {
+        return segment;
+    }
+
+    std::lock_guard<std::mutex> lock(m_segmentsMutex);
+
+    // Someone else may have set it up while we waited, or evicted the segment it belongs to
+    if (jobID < m_lowestActiveIndex.load())
+    {
+        return nullptr;
+    }
+    segment = segmentSlot.load();
+    if ((segment != nullptr) && (segment->m_firstJobID.load() == firstJobID))
+    {
+        return segment;
+    }
+
+    // The ring has come around to segments still held by jobs that never retired, let them go
+    // Retired segments behind the evicted one are recycled as usual
+    while (firstJobID - m_lowestActiveIndex.load() >= RING_CAPACITY)
+    {
+        EvictLowestSegment();
+        ReclaimRetiredSegmentsLocked();
+    }
+
+    if (!m_freeSegments.empty())
+    {
+        segment = m_freeSegments.back();
+        m_freeSegments.pop_back();
+    }
+    else
+    {
+        segment = new Segment();
+        m_allSegments.push_back(segment);
+    }
+
+    for (int i = 0; i < SEGMENT_SIZE; ++i)
+    {
+        segment->m_statuses[i].store((unsigned char)JOB_STATUS_NEVER_SEEN);
+    }
+    segment->m_numRetired.store(0);
+    segment->m_firstJobID.store(firstJobID);
+    segmentSlot.store(segment);
+
+    return segment;
+}
+
+void JobStatusTable::EvictLowestSegment()
+{
+    JobID lowestActiveIndex = m_lowestActiveIndex.load();
+    std::atomic<Segment *> &segmentSlot = m_segments[(lowestActiveIndex / SEGMENT_SIZE) % MAX_SEGMENTS];
+    Segment *segment = segmentSlot.load();
+
+    // Held until the statuses are copied, readers and writers of these IDs wait for the side table
+    std::lock_guard<std::mutex> lockLongLived(m_longLivedJobsMutex);
+    m_lowestActiveIndex.store(lowestActiveIndex + SEGMENT_SIZE);
+    if ((segment == nullptr) || (segment->m_firstJobID.load() != lowestActiveIndex))
+    {
+        return;
+    }
+
+    // Invalidated before the copy, a store that comes after it sees this and goes to the side table.
+    // IDs that never got a status have nothing to keep
+    InvalidateSegment(segment);
+    segmentSlot.store(nullptr);
+    size_t numMoved = 0;
+    for (int i = 0; i < SEGMENT_SIZE; ++i)
+    {
+        JobStatus jobStatus = (JobStatus)segment->m_statuses[i].load();
+        if ((jobStatus != JOB_STATUS_RETIRED) && (jobStatus != JOB_STATUS_NEVER_SEEN))
+        {
+            m_longLivedJobs[lowestActiveIndex + i] = jobStatus;
+            ++numMoved;
+        }
+    }
+    m_numLongLivedJobs.store(m_longLivedJobs.size());
+
+    // No writer can reach it any more, it is reused like a retired one
+    m_freeSegments.push_back(segment);
+    if (numMoved == 0)
+    {
+        return;
+    }
+    std::cerr << "JobStatusTable: " << numMoved << " jobs from Job #" << lowestActiveIndex
+              << " on did not retire within " << RING_CAPACITY << " job IDs, " << m_longLivedJobs.size()
+              << " long-lived jobs are now tracked outside the ring" << std::endl;
+}
+
+void JobStatusTable::ReclaimRetiredSegments()
+{
+    std::lock_guard<std::mutex> lock(m_segmentsMutex);
+    ReclaimRetiredSegmentsLocked();
+}
+
+void JobStatusTable::ReclaimRetiredSegmentsLocked()
+{
+    // Walk up from the lowest active segment while every job in it has retired
+    while (true)
+    {
+        JobID lowestActiveIndex = m_lowestActiveIndex.load();
+        std::atomic<Segment *> &segmentSlot = m_segments[(lowestActiveIndex / SEGMENT_SIZE) % MAX_SEGMENTS];
+        Segment *segment = segmentSlot.load();
+        if ((segment == nullptr) || (segment->m_firstJobID.load() != lowestActiveIndex) ||
+            (segment->m_numRetired.load() != SEGMENT_SIZE))
+        {
+            break;
+        }
+
+        // Move the index first so readers answer retired, then invalidate the segment before clearing it
+        m_lowestActiveIndex.store(lowestActiveIndex + SEGMENT_SIZE);
+        InvalidateSegment(segment);
+        segmentSlot.store(nullptr);
+        m_freeSegments.push_back(segment);
+    }
+}
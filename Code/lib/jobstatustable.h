@@ -0,0 +1,89 @@
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include "jobid.h"
+
+enum JobStatus
+{
+    JOB_STATUS_NEVER_SEEN,
+    JOB_STATUS_QUEUED,
+    JOB_STATUS_RUNNING,
+    JOB_STATUS_COMPLETED,
+    JOB_STATUS_RETIRED,
+    JOB_STATUS_CANCELLED, // Completed by cancellation, either without running or cut short
+    NUM_JOB_STATUSES
+};
+
+// Status of every job keyed by job ID, stored in fixed size segments of atomics so reads never lock.
+// Once every job below a segment boundary has retired, the lowest active index moves past it and
+// the segment is recycled for new IDs, which keeps memory flat no matter how many jobs go through.
+// A job that never retires, like a posted job nobody finishes, would hold every later segment once
+// the ring comes back around to it. When it does, the jobs of the oldest segment that have not
+// retired move to a side table and the segment is recycled too, so only the long-lived jobs pay for
+// a lock and memory stays flat either way.
+class JobStatusTable
+{
+public:
+    JobStatusTable();
+    ~JobStatusTable();
+
+    JobStatus GetJobStatus(JobID jobID) const;
+    void SetJobStatus(JobID jobID, JobStatus jobStatus);
+
+    // Marks the job retired and lets its segment be reclaimed once all of its jobs are retired
+    void RetireJob(JobID jobID);
+
+    JobID GetLowestActiveIndex() const { return m_lowestActiveIndex.load(); }
+    // Jobs below the lowest active index that have not retired
+    size_t GetNumLongLivedJobs() const { return m_numLongLivedJobs.load(); }
+    // Segments allocated so far, live or on the free list
+    size_t GetNumSegments();
+
+    static constexpr int SEGMENT_SIZE = 4096;
+    static constexpr int MAX_SEGMENTS = 4096;
+    // How many job IDs the ring holds before its oldest segment has to go
+    static constexpr JobID RING_CAPACITY = (JobID)SEGMENT_SIZE * MAX_SEGMENTS;
+
+private:
+    struct Segment
+    {
+        // First job ID this segment currently holds, -1 while it sits on the free list
+        std::atomic<JobID> m_firstJobID{INVALID_JOB_ID};
+        std::atomic<int> m_numRetired{0};
+        // Writers between checking m_firstJobID and storing a status, the segment is only
+        // copied and recycled once they are done
+        std::atomic<int> m_numWriters{0};
+        std::atomic<unsigned char> m_statuses[SEGMENT_SIZE];
+    };
+
+    Segment *GetOrCreateSegment(JobID jobID);
+    // Stores the status unless the segment no longer holds the job, returns whether it did
+    static bool StoreJobStatus(Segment *segment, JobID jobID, JobStatus jobStatus);
+    // Invalidates a segment that is leaving the ring, returns once no writer can still store into it
+    static void InvalidateSegment(Segment *segment);
+    void ReclaimRetiredSegments();
+    // Callers hold m_segmentsMutex
+    void ReclaimRetiredSegmentsLocked();
+    void EvictLowestSegment();
+
+    // Jobs below the lowest active index, retired unless the side table has them
+    JobStatus GetLongLivedJobStatus(JobID jobID) const;
+    void SetLongLivedJobStatus(JobID jobID, JobStatus jobStatus);
+
+    // Ring of live segments indexed by segment number, at most MAX_SEGMENTS * SEGMENT_SIZE IDs can be live
+    std::atomic<Segment *> m_segments[MAX_SEGMENTS];
+    // Every job ID below this has retired, in whole segments
+    std::atomic<JobID> m_lowestActiveIndex{0};
+
+    // Slow path only, creating and recycling segments
+    std::vector<Segment *> m_freeSegments;
+    std::vector<Segment *> m_allSegments;
+    std::mutex m_segmentsMutex;
+
+    // Jobs that outlived their evicted segment, only locked for IDs below the lowest active index
+    std::unordered_map<JobID, JobStatus> m_longLivedJobs;
+    std::atomic<size_t> m_numLongLivedJobs{0};
+    mutable std::mutex m_longLivedJobsMutex;
+};
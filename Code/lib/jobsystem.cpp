@@ -1,473 +1,2220 @@
 #include <iostream>
 #include <algorithm>
 #include <functional>
+#include <exception>
+#include <random>
+#include <cmath>
 #include <nlohmann/json.hpp>
 #include "jobsystem.h"
 #include "jobworkerthread.h"
+#include "jobworkerqueue.h"
 #include "job.h"
 
-JobSystem *JobSystem::s_jobSystem = nullptr;
-
 typedef void (*JobCallback)(Job *completedJob);
 
+// Wraps the work handed to Post()
+class PostedJob : public Job
+{
+public:
+    PostedJob(std::function<void()> work, unsigned long jobChannels) : Job(jobChannels), m_work(std::move(work)) {}
+
+    void Execute() override
+    {
+        m_work();
+    }
+
+private:
+    std::function<void()> m_work;
+};
+
 JobSystem::JobSystem()
 {
-    m_jobHistory.reserve(256 * 1024);
+    m_metricsStartTime = std::chrono::steady_clock::now();
+    m_lastMetricsTime = m_metricsStartTime;
+
+    std::lock_guard<JobMutex> lockJobFactory(m_jobFactoriesMutex);
+    m_postedJobMetrics = GetJobTypeMetrics("post");
 }
 
 JobSystem::~JobSystem()
 {
-    std::lock_guard<std::mutex> lock(m_workerThreadMutex);
-    int numWorkerThreads = (int)m_workerThreads.size();
+    // Take the workers out under the lock, but join them without it, a worker may need the lock to finish
+    std::vector<JobWorkerThread *> workerThreads;
+    {
+        std::lock_guard<JobMutex> lock(m_workerThreadMutex);
+        m_isShuttingDown = true;
+        workerThreads.swap(m_workerThreads);
+        workerThreads.insert(workerThreads.end(), m_retiredWorkers.begin(), m_retiredWorkers.end());
+        m_retiredWorkers.clear();
+        RebuildWorkerQueues();
+    }
+
+    int numWorkerThreads = (int)workerThreads.size();
 
     // First, tell each worker thread to stop picking up jobs
     for (int i = 0; i < numWorkerThreads; ++i)
     {
-        m_workerThreads[i]->ShutDown();
+        workerThreads[i]->ShutDown();
     }
 
     // Deleting the job from the queue
-    while (!m_workerThreads.empty())
+    while (!workerThreads.empty())
     {
-        delete m_workerThreads.back();
-        m_workerThreads.pop_back();
+        delete workerThreads.back();
+        workerThreads.pop_back();
     }
-}
 
-JobSystem *JobSystem::CreateOrGet()
-{
-    if (!s_jobSystem)
+    // Stop the reactor before the jobs go, its callbacks complete jobs that are waiting on processes.
+    // Stopped outside the lock, a timeout firing on its thread may still be asking for it
+    std::unique_ptr<JobReactor> reactor;
     {
-        s_jobSystem = new JobSystem();
+        std::lock_guard<JobMutex> lockReactor(m_reactorMutex);
+        reactor = std::move(m_reactor);
     }
-    return s_jobSystem;
-}
+    reactor.reset();
+    m_reactorInstance.store(nullptr);
 
-void JobSystem::Destroy()
-{
-    if (s_jobSystem)
+    // Nothing completes jobs any more, the callback thread runs what is left and stops
+    StopCallbackThread();
+
+    // Jobs that were never finished belong to this instance, nothing can run them once the workers are gone
+    std::lock_guard<JobMutex> lockJobMap(m_jobsMutex);
+    for (auto &jobPair : m_jobs)
     {
-        delete s_jobSystem;
-        s_jobSystem = nullptr;
+        delete jobPair.second;
     }
+    m_jobs.clear();
 }
 
-void JobSystem::CreateWorkerThread(const char *uniqueName, unsigned long workerJobChannels)
+void JobSystem::CreateWorkerThread(const char *uniqueName, unsigned long workerJobChannels, const JobWorkerPlacement &placement)
 {
-    JobWorkerThread *newWorker = new JobWorkerThread(uniqueName, workerJobChannels, this);
-    std::lock_guard<std::mutex> lock(m_workerThreadMutex);
+    JobWorkerThread *newWorker = new JobWorkerThread(uniqueName, workerJobChannels, this, nullptr, placement);
+    std::lock_guard<JobMutex> lock(m_workerThreadMutex);
     m_workerThreads.push_back(newWorker);
+    RebuildWorkerQueues();
 
     m_workerThreads.back()->StartUp();
 }
 
 void JobSystem::DestroyWorkerThread(const char *uniqueName)
 {
-    std::lock_guard<std::mutex> lock(m_workerThreadMutex);
+    JobWorkerThread *doomedWorker = nullptr;
+    {
+        std::lock_guard<JobMutex> lock(m_workerThreadMutex);
 
-    auto it = std::find_if(m_workerThreads.begin(), m_workerThreads.end(), [uniqueName](JobWorkerThread *worker)
-                           { return std::string(worker->m_uniqueName) == uniqueName; });
+        auto it = std::find_if(m_workerThreads.begin(), m_workerThreads.end(), [uniqueName](JobWorkerThread *worker)
+                               { return worker->m_uniqueName == uniqueName; });
+        if (it == m_workerThreads.end())
+        {
+            return;
+        }
 
-    if (it != m_workerThreads.end())
-    {
-        JobWorkerThread *doomedWorker = *it;
+        doomedWorker = *it;
         m_workerThreads.erase(it);
-        doomedWorker->ShutDown();
-        delete doomedWorker;
+        RebuildWorkerQueues();
+        if (doomedWorker->m_elasticPool != nullptr)
+        {
+            doomedWorker->m_elasticPool->m_numWorkers.fetch_sub(1);
+        }
     }
-}
-
-void JobSystem::QueueJob(int jobID)
-{
-    std::lock_guard<std::mutex> lockQueued(m_jobsQueuedMutex);
-
-    std::lock_guard<std::mutex> lockMap(m_jobsMutex);
-    Job *job = m_jobs[jobID];
 
-    // Job history entry
-    std::lock_guard<std::mutex> lockHistory(m_jobHistoryMutex);
+    // Join the worker first, it can still release jobs onto its local queue while finishing its current one
+    std::shared_ptr<JobWorkerQueue> doomedQueue = doomedWorker->m_localQueue;
+    delete doomedWorker;
 
-    m_jobHistory.emplace_back(JobHistoryEntry(job->m_jobType, JOB_STATUS_QUEUED));
-
-    m_jobsQueued.push_back(job);
+    // Hand anything left in the worker's local queue back to the global queue
+    std::deque<Job *> orphanedJobs = doomedQueue->TakeAllJobs();
+    if (!orphanedJobs.empty())
+    {
+        // Once pushed a job can be claimed and deleted, take the channels to wake workers for first
+        std::vector<unsigned long> orphanedJobChannels;
+        {
+            std::lock_guard<JobMutex> lockQueued(m_jobsQueuedMutex);
+            for (Job *orphanedJob : orphanedJobs)
+            {
+                orphanedJobChannels.push_back(orphanedJob->m_jobChannels);
+                PushReadyJob(orphanedJob);
+            }
+        }
+        for (unsigned long jobChannels : orphanedJobChannels)
+        {
+            NotifyJobsAvailable(jobChannels);
+        }
+    }
 }
 
-nlohmann::json JobSystem::GetAJobStatus(const std::string &jobName)
+bool JobSystem::CreateElasticWorkerPool(const std::string &namePrefix, unsigned long jobChannels, int minWorkers, int maxWorkers,
+                                        std::chrono::milliseconds idleTimeout)
 {
-    // Get the status of a job based on its ID
-    // Return the job status as JSON
-
-    std::lock_guard<std::mutex> lockRunning(m_jobsRunningMutex);
-
-    // Find the job by name and get ID
-    auto it = std::find_if(m_jobsRunning.begin(), m_jobsRunning.end(), [&jobName](const Job *job)
-                           { return job->GetJobName() == jobName; });
+    std::lock_guard<JobMutex> lock(m_workerThreadMutex);
 
-    if (it == m_jobsRunning.end())
+    int poolIndex = m_numElasticPools.load();
+    if ((poolIndex >= MAX_JOB_ELASTIC_POOLS) || (jobChannels == 0) || (maxWorkers < 1))
     {
-        return nlohmann::json{{"status", "error"}, {"message", "Job not found"}};
+        std::cerr << "Cannot create elastic worker pool " << namePrefix << std::endl;
+        return false;
     }
 
-    int jobID = (*it)->GetUniqueID();
-    JobStatus jobStatus = GetJobStatus(jobID);
+    JobElasticPool &elasticPool = m_elasticPools[poolIndex];
+    elasticPool.m_namePrefix = namePrefix;
+    elasticPool.m_jobChannels = jobChannels;
+    elasticPool.m_minWorkers = std::max(0, std::min(minWorkers, maxWorkers));
+    elasticPool.m_maxWorkers = maxWorkers;
+    elasticPool.m_idleTimeout = idleTimeout;
+    m_numElasticPools.store(poolIndex + 1);
 
-    // Create a response based on the status
-    std::string statusString;
-    switch (jobStatus)
+    for (int i = 0; i < elasticPool.m_minWorkers; ++i)
     {
-    case JOB_STATUS_COMPLETED:
-        statusString = "completed";
-        break;
-    case JOB_STATUS_RUNNING:
-        statusString = "in progress";
-        break;
-    case JOB_STATUS_QUEUED:
-        statusString = "queued";
-        break;
-    case JOB_STATUS_RETIRED:
-        statusString = "retired";
-        break;
-    case JOB_STATUS_NEVER_SEEN:
-        statusString = "never seen";
-        break;
-    default:
-        statusString = "unknown";
-        break;
+        StartElasticWorker(elasticPool);
     }
+    return true;
+}
 
-    return nlohmann::json{{"status", statusString}};
+void JobSystem::StartElasticWorker(JobElasticPool &elasticPool)
+{
+    // Caller holds m_workerThreadMutex
+    std::string workerName = elasticPool.m_namePrefix + " " + std::to_string(elasticPool.m_nextWorkerIndex++);
+    JobWorkerThread *newWorker = new JobWorkerThread(workerName.c_str(), elasticPool.m_jobChannels, this, &elasticPool);
+    m_workerThreads.push_back(newWorker);
+    elasticPool.m_numWorkers.fetch_add(1);
+    RebuildWorkerQueues();
+
+    newWorker->StartUp();
 }
 
-std::vector<std::string> JobSystem::GetAvailableJobTypes()
+void JobSystem::ReapRetiredWorkers()
 {
-    return m_availableJobTypes;
+    // Caller holds m_workerThreadMutex. Retired workers have already left their loop, joining is quick
+    for (JobWorkerThread *retiredWorker : m_retiredWorkers)
+    {
+        delete retiredWorker;
+    }
+    m_retiredWorkers.clear();
 }
 
-void JobSystem::RegisterJobType(const std::string &jobType, std::function<Job *()> jobFactory)
+void JobSystem::OnJobReleased(unsigned long jobChannels)
 {
-    std::lock_guard<std::mutex> lockJobFactory(m_jobFactoriesMutex);
-    m_jobFactories[jobType] = jobFactory;
+    int numElasticPools = m_numElasticPools.load();
+    for (int i = 0; i < numElasticPools; ++i)
+    {
+        JobElasticPool &elasticPool = m_elasticPools[i];
+        if ((jobChannels & elasticPool.m_jobChannels) == 0)
+        {
+            continue;
+        }
 
-    std::lock_guard<std::mutex> lockJobTypes(m_availableJobTypeMutex);
-    m_availableJobTypes.push_back(jobType);
+        // Every worker is busy with (or about to take) one of the pool's jobs, add one for this job
+        int numActiveJobs = elasticPool.m_numActiveJobs.fetch_add(1) + 1;
+        if ((numActiveJobs > elasticPool.m_numWorkers.load()) && (elasticPool.m_numWorkers.load() < elasticPool.m_maxWorkers))
+        {
+            std::lock_guard<JobMutex> lock(m_workerThreadMutex);
+            ReapRetiredWorkers();
+            if (!m_isShuttingDown && (elasticPool.m_numActiveJobs.load() > elasticPool.m_numWorkers.load()) &&
+                (elasticPool.m_numWorkers.load() < elasticPool.m_maxWorkers))
+            {
+                StartElasticWorker(elasticPool);
+            }
+        }
+    }
 }
 
-nlohmann::json JobSystem::CreateJob(const std::string &jobType, nlohmann::json &input)
+bool JobSystem::RetireElasticWorker(JobWorkerThread *worker)
 {
-    // Create a job of the specified type and provide the input data
-    // return the job ID or status
-    std::lock_guard<std::mutex> lockFactory(m_jobFactoriesMutex);
-    std::lock_guard<std::mutex> lockDependencies(m_jobDependenciesMutex);
+    JobElasticPool *elasticPool = worker->m_elasticPool;
+    if (elasticPool == nullptr)
+    {
+        return false;
+    }
 
-    auto it = m_jobFactories.find(jobType);
+    std::lock_guard<JobMutex> lock(m_workerThreadMutex);
 
-    if (it == m_jobFactories.end())
+    // Stay while the pool is at its minimum, still has work for us, or we have jobs others would have to steal
+    if (m_isShuttingDown || worker->IsStopping() ||
+        (elasticPool->m_numWorkers.load() <= elasticPool->m_minWorkers) ||
+        (elasticPool->m_numActiveJobs.load() >= elasticPool->m_numWorkers.load()) ||
+        !worker->m_localQueue->IsEmpty())
     {
-        // Factory not found, return an error json
-        return nlohmann::json{{"error", "Job type not registered"}};
+        return false;
     }
 
-    // Create a new instance of the job type
-    Job *job = it->second();
-    if (job == nullptr)
+    auto it = std::find(m_workerThreads.begin(), m_workerThreads.end(), worker);
+    if (it == m_workerThreads.end())
     {
-        // Failed to create job, return an error json
-        return nlohmann::json{{"error", "Failed to create job instance"}};
+        return false;
     }
 
-    // Initialize the job with input
-    job->SetInput(input);
-
-    // Mapping job names to their unique ID value to use in the SetDependency function
-    std::lock_guard<std::mutex> lockJobNameID(m_jobNameToIDMutex);
-    m_jobNameToID[jobType] = job->GetUniqueID();
-
-    std::lock_guard<std::mutex> lockJobMap(m_jobsMutex);
-    m_jobs[job->GetUniqueID()] = job;
+    m_workerThreads.erase(it);
+    RebuildWorkerQueues();
+    elasticPool->m_numWorkers.fetch_sub(1);
+    m_retiredWorkers.push_back(worker);
+    return true;
+}
 
-    // /*
-    //     TODO This code queues the job in the system, but maybe we should create
-    //     another function that calls for dependencies to be set before queuing
-    //     the job:
+void JobSystem::RebuildWorkerQueues()
+{
+    // Caller holds m_workerThreadMutex
+    auto workerQueues = std::make_shared<std::vector<std::shared_ptr<JobWorkerQueue>>>();
+    for (JobWorkerThread *worker : m_workerThreads)
+    {
+        workerQueues->push_back(worker->m_localQueue);
+    }
 
-    // // Store the job in the system
-    // std::lock_guard<std::mutex> lockQueued(m_jobsQueuedMutex);
+    std::lock_guard<JobMutex> lock(m_workerQueuesMutex);
+    m_workerQueues = workerQueues;
+}
 
-    // // Job history entry
-    // std::lock_guard<std::mutex> lockHistory(m_jobHistoryMutex);
-    // m_jobHistory.emplace_back(JobHistoryEntry(job->m_jobType, JOB_STATUS_QUEUED));
+JobHandle JobSystem::QueueJob(JobID jobID)
+{
+    Job *job = GetJob(jobID);
+    if (job == nullptr)
+    {
+        std::cerr << "Cannot queue Job #" << jobID << " - no such job in JobSystem!" << std::endl;
+        return JobHandle();
+    }
 
-    // m_jobsQueued.push_back(job);
-    // */
+    // Grab the handle first, the job can complete and be deleted as soon as it is released
+    JobHandle jobHandle(jobID, job->m_completionState);
 
-    // Return a JSON object with the job ID and other details
-    nlohmann::json response = {
-        {"jobId", job->GetUniqueID()},
-        {"status", "Job created"},
-        {"dependencies", m_jobDependencies[job->GetUniqueID()]}};
+    // Queueing drops the pending count CreateJob holds for it. A job still waiting on dependencies is
+    // not put on a ready queue, OnJobCompleted releases it once its last dependency completes
+    if (MarkJobQueued(job) && (job->m_pendingDependencies.fetch_sub(1) == 1))
+    {
+        ReleaseJob(job);
+    }
 
-    return response;
+    return jobHandle;
 }
 
-void JobSystem::SetDependency(const std::string &dependentJobName, const std::string &dependencyJobName)
+JobHandle JobSystem::QueueJobAfter(JobID jobID, JobID previousJobID)
 {
+    Job *job = GetJob(jobID);
+    if (job == nullptr)
+    {
+        std::cerr << "Cannot queue Job #" << jobID << " - no such job in JobSystem!" << std::endl;
+        return JobHandle();
+    }
 
-    // Go through job factories and find matching job name
-    std::lock_guard<std::mutex> lockFactory(m_jobFactoriesMutex);
-
-    // Check if dependent job is registered
-    auto dependentJobIter = m_jobFactories.find(dependentJobName);
-    if (dependentJobIter == m_jobFactories.end())
+    if (job->m_isReleased.load())
     {
-        // Dependent job factory not found, handle error...
-        std::cerr << "Dependent job factory not found for job: " << dependentJobName << std::endl;
-        return;
+        std::cerr << "Job #" << jobID << " is already running, too late to continue Job #" << previousJobID << std::endl;
+        return JobHandle(jobID, job->m_completionState);
     }
 
-    // Check if dependency job is registered
-    auto dependencyJobIter = m_jobFactories.find(dependencyJobName);
-    if (dependencyJobIter == m_jobFactories.end())
+    // A previous job that is no longer in the system was finished long ago, there is nothing to wait for
+    Job *previousJob = GetJob(previousJobID);
+    if (previousJob != nullptr)
     {
-        // Factory not found, return an error json
-        std::cerr << "Dependency job factory not found for job: " << dependencyJobName << std::endl;
-        return;
+        AddSuccessor(previousJob, job);
     }
 
-    // Checking map for id values of job names
-    std::lock_guard<std::mutex> lockJobIDMap(m_jobNameToIDMutex);
-    int dependentJobId = m_jobNameToID[dependentJobName];
-    int dependencyJobId = m_jobNameToID[dependencyJobName];
+    return QueueJob(jobID);
+}
+
+bool JobCancelToken::Cancel(const std::string &reason) const
+{
+    return (m_jobSystem != nullptr) && m_jobSystem->CancelJob(m_jobID, reason);
+}
 
-    // Assigning dependency map with id values of dependent jobs
-    std::lock_guard<std::mutex> lock(m_jobDependenciesMutex);
-    // std::cout << "\nSetting dependency. Dependent Job ID: " << dependentJobId
-    //           << " (" << dependentJobName << "), Dependency Job ID: " << dependencyJobId
-    //           << " (" << dependencyJobName << ")" << std::endl;
-    m_jobDependencies[dependentJobId].push_back(dependencyJobId);
+JobCancelToken JobSystem::GetCancelToken(JobID jobID)
+{
+    return JobCancelToken(this, jobID);
 }
 
-// Checking job dependencies for a specific job
-bool JobSystem::AreDependenciesResolved(int jobID)
+bool JobSystem::CancelJob(JobID jobID, const std::string &reason)
 {
-    std::lock_guard<std::mutex> lockDependencies(m_jobDependenciesMutex);
+    return CancelJobAttempt(jobID, reason, 0);
+}
 
-    // Check if the job has dependencies based on its unique ID
-    auto dependenciesIt = m_jobDependencies.find(jobID);
-    if (dependenciesIt == m_jobDependencies.end())
+bool JobSystem::CancelJobAttempt(JobID jobID, const std::string &reason, int attempt)
+{
+    // Nothing downstream can run without this job's output. Successors are cancelled from a worklist,
+    // so a long chain does not take one stack frame per job
+    std::vector<JobID> cancelledSuccessorIDs;
+    if (!CancelSingleJob(jobID, reason, attempt, cancelledSuccessorIDs))
     {
-        // No dependencies for this job
-        return true;
+        return false;
+    }
+
+    while (!cancelledSuccessorIDs.empty())
+    {
+        JobID successorID = cancelledSuccessorIDs.back();
+        cancelledSuccessorIDs.pop_back();
+        CancelSingleJob(successorID, "dependency cancelled", 0, cancelledSuccessorIDs);
     }
+    return true;
+}
 
-    // Iterate over all dependencies and check their status
-    for (int dependencyID : dependenciesIt->second)
+bool JobSystem::CancelSingleJob(JobID jobID, const std::string &reason, int attempt, std::vector<JobID> &cancelledSuccessorIDs)
+{
+    Job *job = nullptr;
     {
-        // Check status for a job given id from its pair
-        if (!IsJobComplete(dependencyID))
+        std::unique_lock<JobMutex> lockMap(m_jobsMutex);
+        auto jobIter = m_jobs.find(jobID);
+        if (jobIter == m_jobs.end())
+        {
+            return false;
+        }
+
+        // While we hold the successor lock the job cannot complete, so it cannot be finished and deleted either
+        job = jobIter->second;
+        std::lock_guard<JobMutex> lockSuccessors(job->m_successorsMutex);
+        lockMap.unlock();
+
+        if (job->m_hasCompleted || job->m_isCancelled.load() || ((attempt != 0) && (job->m_attempt.load() != attempt)))
         {
-            // If any dependency is not completed, returns false
             return false;
         }
+
+        job->m_cancelReason = reason;
+        job->m_isCancelled.store(true);
+        cancelledSuccessorIDs.insert(cancelledSuccessorIDs.end(), job->m_successorIDs.begin(), job->m_successorIDs.end());
+
+        // OnCancel() may call into the reactor, whose thread completes jobs under this lock. The
+        // reference keeps the job alive if it completes and is finished in the meantime
+        job->m_numReferences.fetch_add(1);
     }
 
-    // All dependencies are completed
+    job->OnCancel();
+    ReleaseJobReference(job);
     return true;
 }
 
-JobStatus JobSystem::GetJobStatus(int jobID) const
+void JobSystem::ReleaseJobReference(Job *job)
 {
-    std::lock_guard<std::mutex> lockHistory(m_jobHistoryMutex);
-
-    JobStatus jobStatus = JOB_STATUS_NEVER_SEEN;
-    if (jobID < (int)m_jobHistory.size())
+    if (job->m_numReferences.fetch_sub(1) == 1)
     {
-        jobStatus = (JobStatus)(m_jobHistory[jobID].m_jobStatus);
+        delete job;
     }
-
-    return jobStatus;
 }
 
-bool JobSystem::IsJobComplete(int jobID) const
+void JobSystem::SetCancelledOutput(Job *job)
 {
-    return (GetJobStatus(jobID)) == (JOB_STATUS_COMPLETED);
+    nlohmann::json jsonOutput;
+    jsonOutput["status"] = "cancelled";
+    {
+        std::lock_guard<JobMutex> lockSuccessors(job->m_successorsMutex);
+        jsonOutput["reason"] = job->m_cancelReason;
+    }
+    job->SetOutput(std::move(jsonOutput));
 }
 
-void JobSystem::FinishCompletedJobs()
+JobHandle JobSystem::GetJobHandle(JobID jobID) const
 {
-    // Creating a double ended queue for holding completed jobs
-    std::deque<Job *> jobsCompleted;
-
-    std::lock_guard<std::mutex> lockCompleted(m_jobsCompletedMutex);
-    jobsCompleted.swap(m_jobsCompleted);
-
-    // Iterating through jobs in jobsCompleted
-    // and calling each job's individual callback functions
-    for (Job *job : jobsCompleted)
+    std::lock_guard<JobMutex> lockMap(m_jobsMutex);
+    auto jobIter = m_jobs.find(jobID);
+    if (jobIter == m_jobs.end())
     {
-        job->JobCompleteCallback();
-
-        // Changing the status of the job in the jobHistory vector
-        std::lock_guard<std::mutex> lockHistory(m_jobHistoryMutex);
-        m_jobHistory[job->m_jobID].m_jobStatus = JOB_STATUS_RETIRED;
-        delete job;
+        return JobHandle();
     }
+    return JobHandle(jobID, jobIter->second->m_completionState);
 }
 
-nlohmann::json JobSystem::FinishJob(int jobID)
+Job *JobSystem::GetJob(JobID jobID) const
 {
-    nlohmann::json response;
-
-    JobStatus jobStatus = GetJobStatus(jobID);
+    std::lock_guard<JobMutex> lockMap(m_jobsMutex);
+    auto jobIter = m_jobs.find(jobID);
+    return (jobIter != m_jobs.end()) ? jobIter->second : nullptr;
+}
 
-    // Checking job status before finishing the job
-    if ((jobStatus == JOB_STATUS_NEVER_SEEN) || (jobStatus == JOB_STATUS_RETIRED))
+bool JobSystem::MarkJobQueued(Job *job)
+{
+    // Only the first QueueJob records the job as queued
+    if (job->m_isQueued.exchange(true))
     {
-        response["status"] = "error";
-        response["message"] = "Waiting for Job(#:" + std::to_string(jobID) + ") - no such job in JobSystem!";
-        return response;
+        return false;
     }
 
-    while (!IsJobComplete(jobID))
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    job->m_timeline.m_queuedTime = JobTimeline::Now();
+    m_jobHistory.SetJobStatus(job->m_jobID, JOB_STATUS_QUEUED);
+    return true;
+}
 
-    // Accessing the jobsCompleted deque
-    std::lock_guard<std::mutex> lockCompleted(m_jobsCompletedMutex);
-    Job *thisCompletedJob = nullptr;
-    for (auto jqIter = m_jobsCompleted.begin(); jqIter != m_jobsCompleted.end(); ++jqIter)
+void JobSystem::ReleaseJob(Job *job)
+{
+    // QueueJob and the last dependency completing can race to release the same job, only one wins
+    if (job->m_isReleased.exchange(true))
     {
-        Job *someCompletedJob = *jqIter;
-        if (someCompletedJob->m_jobID == jobID)
-        {
-            // For matching jobID, delete the job from the jobsCompleted deque
-            thisCompletedJob = someCompletedJob;
-            m_jobsCompleted.erase(jqIter);
-            break;
-        }
+        return;
     }
-
-    if (thisCompletedJob == nullptr)
+    job->m_timeline.m_releasedTime = JobTimeline::Now();
+
+    // Account for the job before it can be claimed, it may complete and be deleted as soon as it is pushed
+    unsigned long jobChannels = job->m_jobChannels;
+    OnJobReleased(jobChannels);
+
+    // Jobs released by one of our workers (usually dependents released by OnJobCompleted) go on
+    // that worker's local queue when it can run them, everything else goes on the global queues.
+    // Local queues ignore priority, so any job that is not of normal priority goes through the global
+    // queues, where a low priority job also waits behind the normal ones instead of ahead of them
+    JobWorkerThread *currentWorker = JobWorkerThread::GetCurrentWorker();
+    if ((currentWorker != nullptr) && (currentWorker->m_jobSystem == this) && !IsScheduledJob(job) &&
+        ((job->m_jobChannels & currentWorker->GetWorkerJobChannels()) != 0))
     {
-        response["status"] = "error";
-        response["message"] = "Job #" + std::to_string(jobID) + " was status complete but not found in Completed List of jobs";
-        return response;
+        currentWorker->m_localQueue->PushJob(job);
     }
     else
     {
-        // Call the job's callback function
-        thisCompletedJob->JobCompleteCallback();
-
-        // Change the status of the job in the jobHistory vector
-        std::lock_guard<std::mutex> lockHistory(m_jobHistoryMutex);
-        m_jobHistory[thisCompletedJob->m_jobID].m_jobStatus = JOB_STATUS_RETIRED;
-
-        // Handle the memory for the job
-        delete thisCompletedJob;
-
-        // If we reach this point, it means the job has been successfully finished
-        response["status"] = "success";
-        response["message"] = "Job #" + std::to_string(jobID) + " finished successfully";
-        return response;
+        std::lock_guard<JobMutex> lockQueued(m_jobsQueuedMutex);
+        PushReadyJob(job);
     }
 
-    // If job is already complete by the time we check
-    response["status"] = "success";
-    response["message"] = "Job #" + std::to_string(jobID) + " was already completed";
-    return response;
+    // Wake an idle worker so it can claim the job (or steal it) right away
+    NotifyJobsAvailable(jobChannels);
 }
 
-void JobSystem::OnJobCompleted(Job *jobJustExecuted)
+unsigned long long JobSystem::GetJobsAvailableGeneration() const
 {
-    // Protect the jobCompleted and jobRunning deques
-    std::lock_guard<std::mutex> lockCompleted(m_jobsCompletedMutex);
-    std::lock_guard<std::mutex> lockRunning(m_jobsRunningMutex);
+    std::lock_guard<JobMutex> lock(m_jobsAvailableMutex);
+    return m_jobsAvailableGeneration;
+}
 
-    std::deque<Job *>::iterator runningJobItr = m_jobsRunning.begin();
-    for (; runningJobItr != m_jobsRunning.end(); ++runningJobItr)
+bool JobSystem::WaitForJobsAvailable(unsigned long long seenGeneration, JobWorkerThread *worker, unsigned long workerJobChannels)
+{
+    // A job released after the worker last looked is worth another look instead of a sleep
+    JobWaitLock lock(m_jobsAvailableMutex);
+    if ((m_jobsAvailableGeneration != seenGeneration) || worker->IsStopping())
     {
-        if (jobJustExecuted == *runningJobItr)
-        {
-            // Protect the jobHistory vector
-            std::lock_guard<std::mutex> lockHistory(m_jobHistoryMutex);
-            // Remove the job from the running deque
-            m_jobsRunning.erase(runningJobItr);
-            // Add the job to the jobs completed deque
-            m_jobsCompleted.push_back(jobJustExecuted);
-            // Changed the status of the job in the job history vector
-            m_jobHistory[jobJustExecuted->m_jobID].m_jobStatus = JOB_STATUS_COMPLETED;
-            break;
-        }
-        if (runningJobItr == m_jobsRunning.end())
-        {
-            std::cout << "Job ID: " << jobJustExecuted->GetUniqueID() << " not found in the running jobs."
-                      << std::endl;
-        }
+        return true;
     }
 
-    // Getting output from previous job to set as input for next
-    nlohmann::json output = jobJustExecuted->GetOutput();
+    // Block until a job on our channels is released, or the worker is told to stop
+    worker->m_idleJobChannels = workerJobChannels;
+    worker->m_isNotified = false;
+    m_idleWorkers.push_back(worker);
+    auto isWoken = [worker]()
+    { return worker->m_isNotified; };
 
-    for (auto iter = m_jobDependencies.begin(); iter != m_jobDependencies.end(); ++iter)
+    if (worker->m_elasticPool != nullptr)
     {
-        int depJobId = iter->first;
-        std::vector<int> &dependencies = iter->second;
-        auto findIter = std::find(dependencies.begin(), dependencies.end(), jobJustExecuted->GetUniqueID());
-        if (findIter != dependencies.end())
+        if (!worker->m_jobsAvailableCondition.wait_for(lock, worker->m_elasticPool->m_idleTimeout, isWoken))
         {
-            Job *dependentJob = m_jobs[depJobId];
-            dependentJob->SetInput(output);
+            m_idleWorkers.erase(std::find(m_idleWorkers.begin(), m_idleWorkers.end(), worker));
+            return false;
+        }
+        return true;
+    }
 
-            // Check if all dependencies of the dependent job are now resolved
-            if (AreDependenciesResolved(depJobId))
-            {
-                // Queue the dependent job for execution
-                QueueJob(depJobId);
-            }
+    worker->m_jobsAvailableCondition.wait(lock, isWoken);
+    return true;
+}
 
-            // Since we found and processed the dependency, we can remove it from the list.
-            dependencies.erase(findIter);
+void JobSystem::NotifyJobsAvailable(unsigned long jobChannels)
+{
+    std::lock_guard<JobMutex> lock(m_jobsAvailableMutex);
+    ++m_jobsAvailableGeneration;
 
-            // If after removing the resolved dependency the list is empty, we can remove the entry from the map.
-            if (dependencies.empty())
-            {
-                m_jobDependencies.erase(iter);
-                // Need to break because we've modified the iterator.
-                break;
-            }
+    // Workers that cannot run the jobs stay asleep. The most recently idle worker goes first, its
+    // caches are the warmest. If none is idle, a busy worker finds the jobs when it looks again
+    for (size_t i = m_idleWorkers.size(); i > 0; --i)
+    {
+        JobWorkerThread *idleWorker = m_idleWorkers[i - 1];
+        if ((idleWorker->m_idleJobChannels & jobChannels) != 0)
+        {
+            idleWorker->m_isNotified = true;
+            idleWorker->m_jobsAvailableCondition.notify_one();
+            m_idleWorkers.erase(m_idleWorkers.begin() + (i - 1));
+            return;
         }
     }
 }
 
-Job *JobSystem::ClaimAJob(unsigned long workerJobChannels)
+void JobSystem::WakeWorker(JobWorkerThread *worker)
 {
-    // Protect the queued jobs and jobs running deques
-    std::lock_guard<std::mutex> lockQueued(m_jobsQueuedMutex);
-    std::lock_guard<std::mutex> lockRunning(m_jobsRunningMutex);
+    std::lock_guard<JobMutex> lock(m_jobsAvailableMutex);
+    auto idleIter = std::find(m_idleWorkers.begin(), m_idleWorkers.end(), worker);
+    if (idleIter != m_idleWorkers.end())
+    {
+        worker->m_isNotified = true;
+        worker->m_jobsAvailableCondition.notify_one();
+        m_idleWorkers.erase(idleIter);
+    }
+}
 
-    Job *claimedJob = nullptr;
+nlohmann::json JobSystem::GetAJobStatus(const std::string &jobName)
+{
+    // Get the status of a job based on its ID
+    // Return the job status as JSON
 
-    std::deque<Job *>::iterator queuedJobItr = m_jobsQueued.begin();
-    for (; queuedJobItr != m_jobsQueued.end(); ++queuedJobItr)
-    {
-        Job *queuedJob = *queuedJobItr;
+    std::lock_guard<JobMutex> lockRunning(m_jobsRunningMutex);
 
-        if ((queuedJob->m_jobChannels & workerJobChannels) != 0)
-        {
-            claimedJob = queuedJob;
+    // Find the job by name and get ID
+    auto it = std::find_if(m_jobsRunning.begin(), m_jobsRunning.end(), [&jobName](const Job *job)
+                           { return job->GetJobName() == jobName; });
+
+    if (it == m_jobsRunning.end())
+    {
+        return nlohmann::json{{"status", "error"}, {"message", "Job not found"}};
+    }
 
-            // Protect the job history vector
-            std::lock_guard<std::mutex> lockHistory(m_jobHistoryMutex);
-            // Remove the job from the job queue
-            m_jobsQueued.erase(queuedJobItr);
-            // Add the job to the running jobs deque
-            m_jobsRunning.push_back(queuedJob);
-            // Change the job status of the job in the job history vector
-            m_jobHistory[claimedJob->m_jobID].m_jobStatus = JOB_STATUS_RUNNING;
+    JobID jobID = (*it)->GetUniqueID();
+    JobStatus jobStatus = GetJobStatus(jobID);
 
-            break;
-        }
+    // Create a response based on the status
+    std::string statusString;
+    switch (jobStatus)
+    {
+    case JOB_STATUS_COMPLETED:
+        statusString = "completed";
+        break;
+    case JOB_STATUS_RUNNING:
+        statusString = "in progress";
+        break;
+    case JOB_STATUS_QUEUED:
+        statusString = "queued";
+        break;
+    case JOB_STATUS_RETIRED:
+        statusString = "retired";
+        break;
+    case JOB_STATUS_CANCELLED:
+        statusString = "cancelled";
+        break;
+    case JOB_STATUS_NEVER_SEEN:
+        statusString = "never seen";
+        break;
+    default:
+        statusString = "unknown";
+        break;
     }
 
-    return claimedJob;
-}
\ No newline at end of file
+    return nlohmann::json{{"status", statusString}};
+}
+
+std::vector<std::string> JobSystem::GetAvailableJobTypes()
+{
+    std::lock_guard<JobMutex> lockJobTypes(m_availableJobTypeMutex);
+    return m_availableJobTypes;
+}
+
+void JobSystem::RegisterJobType(const std::string &jobType, std::function<Job *()> jobFactory, unsigned long jobChannels)
+{
+    std::lock_guard<JobMutex> lockJobFactory(m_jobFactoriesMutex);
+    // Registering a type again only replaces its factory, it is listed once
+    bool isNewJobType = (m_jobFactories.find(jobType) == m_jobFactories.end());
+    m_jobFactories[jobType] = jobFactory;
+    GetJobTypeMetrics(jobType);
+    if (jobChannels != 0)
+    {
+        m_jobTypeChannels[jobType] = jobChannels;
+    }
+    else
+    {
+        m_jobTypeChannels.erase(jobType);
+    }
+
+    if (isNewJobType)
+    {
+        std::lock_guard<JobMutex> lockJobTypes(m_availableJobTypeMutex);
+        m_availableJobTypes.push_back(jobType);
+    }
+}
+
+void JobSystem::SetRetryPolicy(const std::string &jobType, const JobRetryPolicy &retryPolicy)
+{
+    std::lock_guard<JobMutex> lockJobFactory(m_jobFactoriesMutex);
+    m_jobTypeRetryPolicies[jobType] = retryPolicy;
+}
+
+nlohmann::json JobSystem::CreateJob(const std::string &jobType, nlohmann::json &input)
+{
+    return CreateJob(jobType, input, DEFAULT_JOB_RUN_ID);
+}
+
+JobRunID JobSystem::CreateGraphRun()
+{
+    // An empty name map marks the run as open until its last named job is finished
+    JobRunID runID = m_nextRunID.fetch_add(1);
+    std::lock_guard<JobMutex> lockGraphRuns(m_graphRunsMutex);
+    m_graphRuns[runID];
+    return runID;
+}
+
+void JobSystem::CloseGraphRun(JobRunID runID)
+{
+    std::lock_guard<JobMutex> lockGraphRuns(m_graphRunsMutex);
+    auto runIter = m_graphRuns.find(runID);
+    if ((runIter != m_graphRuns.end()) && runIter->second.empty() && (runID != DEFAULT_JOB_RUN_ID))
+    {
+        m_graphRuns.erase(runIter);
+    }
+}
+
+nlohmann::json JobSystem::CreateJob(const std::string &jobType, nlohmann::json &input, JobRunID runID,
+                                    const std::string &jobName)
+{
+    // Create a job of the specified type and provide the input data
+    // return the job ID or status
+    std::string error;
+    JobID jobID = CreateJob(jobType, Job::MakePayload(nlohmann::json(input)), runID, jobName, error);
+    if (jobID == INVALID_JOB_ID)
+    {
+        return nlohmann::json{{"error", error}};
+    }
+
+    // Return a JSON object with the job ID and other details, a new job has no dependencies yet.
+    // Built key by key, an initializer list makes a temporary array for every pair
+    nlohmann::json response;
+    response["jobId"] = jobID;
+    response["runId"] = runID;
+    response["status"] = "Job created";
+    response["dependencies"] = nlohmann::json::array();
+
+    return response;
+}
+
+JobID JobSystem::CreateJob(const std::string &jobType, Job::Payload input, JobRunID runID, const std::string &jobName,
+                           std::string &error)
+{
+    if (!input)
+    {
+        input = Job::GetEmptyPayload();
+    }
+    error = GetSchedulingHintsError(*input);
+    if (!error.empty())
+    {
+        return INVALID_JOB_ID;
+    }
+
+    std::lock_guard<JobMutex> lockFactory(m_jobFactoriesMutex);
+
+    auto it = m_jobFactories.find(jobType);
+
+    if (it == m_jobFactories.end())
+    {
+        error = "Job type not registered";
+        return INVALID_JOB_ID;
+    }
+
+    // Create a new instance of the job type
+    Job *job = it->second();
+    if (job == nullptr)
+    {
+        error = "Failed to create job instance";
+        return INVALID_JOB_ID;
+    }
+
+    job->m_jobID = m_nextJobID.fetch_add(1);
+    job->m_jobSystem = this;
+    job->m_jobTypeName = jobType;
+    job->m_typeMetrics = GetJobTypeMetrics(jobType);
+
+    auto channelsIter = m_jobTypeChannels.find(jobType);
+    if (channelsIter != m_jobTypeChannels.end())
+    {
+        job->m_jobChannels = channelsIter->second;
+    }
+    auto retryPolicyIter = m_jobTypeRetryPolicies.find(jobType);
+    if (retryPolicyIter != m_jobTypeRetryPolicies.end())
+    {
+        job->m_retryPolicy = retryPolicyIter->second;
+    }
+
+    // Initialize the job with input, shared with the caller rather than copied
+    ReadSchedulingHints(job, *input);
+    job->SetInput(std::move(input));
+
+    // Not being queued yet counts as a pending dependency, so its dependencies completing never
+    // release the job before QueueJob does
+    job->m_pendingDependencies.store(1);
+
+    // Naming the job within its run, for the SetDependency function
+    if (!NameJob(job, runID, jobName.empty() ? jobType : jobName))
+    {
+        // Its ID is used up, retire it so it does not hold back the status table
+        m_jobHistory.RetireJob(job->m_jobID);
+        delete job;
+        error = "Graph run " + std::to_string(runID) + " was not created or has finished";
+        return INVALID_JOB_ID;
+    }
+
+    std::lock_guard<JobMutex> lockJobMap(m_jobsMutex);
+    m_jobs[job->GetUniqueID()] = job;
+
+    // /*
+    //     TODO This code queues the job in the system, but maybe we should create
+    //     another function that calls for dependencies to be set before queuing
+    //     the job:
+
+    // // Store the job in the system
+    // std::lock_guard<JobMutex> lockQueued(m_jobsQueuedMutex);
+
+    // // Job history entry
+    // m_jobHistory.SetJobStatus(job->m_jobID, JOB_STATUS_QUEUED);
+
+    // m_jobsQueued.push_back(job);
+    // */
+
+    return job->GetUniqueID();
+}
+
+nlohmann::json JobSystem::SubmitGraph(const nlohmann::json &graphSpec)
+{
+    nlohmann::json response;
+
+    // Validate the batch before creating anything, a bad spec leaves the job system untouched
+    if (!graphSpec.is_object() || !graphSpec.contains("jobs") || !graphSpec["jobs"].is_array())
+    {
+        response["error"] = "Graph spec needs a \"jobs\" array";
+        return response;
+    }
+
+    const nlohmann::json &jobSpecs = graphSpec["jobs"];
+    const nlohmann::json noEdges = nlohmann::json::array();
+    const nlohmann::json &edgeSpecs = graphSpec.contains("edges") ? graphSpec["edges"] : noEdges;
+    if (!edgeSpecs.is_array())
+    {
+        response["error"] = "Graph spec \"edges\" must be an array";
+        return response;
+    }
+
+    if (graphSpec.contains("runId") && !graphSpec["runId"].is_number_integer())
+    {
+        response["error"] = "Graph spec \"runId\" must be an integer";
+        return response;
+    }
+
+    // Only runs from CreateGraphRun() that are still open, another graph's names are not ours to take.
+    // Checked again when the batch is published, the run may finish in between
+    if (graphSpec.contains("runId"))
+    {
+        JobRunID specRunID = graphSpec["runId"].get<JobRunID>();
+        std::lock_guard<JobMutex> lockGraphRuns(m_graphRunsMutex);
+        if ((specRunID != DEFAULT_JOB_RUN_ID) && (m_graphRuns.find(specRunID) == m_graphRuns.end()))
+        {
+            response["error"] = "Graph run " + std::to_string(specRunID) + " was not created or has finished";
+            return response;
+        }
+    }
+
+    size_t numJobs = jobSpecs.size();
+    std::vector<std::string> jobNames;
+    std::unordered_map<std::string, size_t> jobIndices;
+    jobNames.reserve(numJobs);
+    for (size_t i = 0; i < numJobs; ++i)
+    {
+        const nlohmann::json &jobSpec = jobSpecs[i];
+        if (!jobSpec.is_object() || !jobSpec.contains("type") || !jobSpec["type"].is_string())
+        {
+            response["error"] = "Job spec #" + std::to_string(i) + " needs a \"type\"";
+            return response;
+        }
+        if (jobSpec.contains("name") && !jobSpec["name"].is_string())
+        {
+            response["error"] = "Job spec #" + std::to_string(i) + " \"name\" must be a string";
+            return response;
+        }
+        if (jobSpec.contains("input"))
+        {
+            std::string hintsError = GetSchedulingHintsError(jobSpec["input"]);
+            if (!hintsError.empty())
+            {
+                response["error"] = "Job spec #" + std::to_string(i) + ": " + hintsError;
+                return response;
+            }
+        }
+
+        std::string jobName = jobSpec.value("name", jobSpec["type"].get<std::string>());
+        if (!jobIndices.emplace(jobName, i).second)
+        {
+            response["error"] = "Duplicate job name in graph: " + jobName;
+            return response;
+        }
+        jobNames.push_back(jobName);
+    }
+
+    // Edges as indices into the batch, with the pending dependency count of every job
+    std::vector<std::vector<size_t>> successors(numJobs);
+    std::vector<int> pendingDependencies(numJobs, 0);
+    for (const nlohmann::json &edgeSpec : edgeSpecs)
+    {
+        if (!edgeSpec.is_object() || !edgeSpec.contains("dependent") || !edgeSpec["dependent"].is_string() ||
+            !edgeSpec.contains("dependency") || !edgeSpec["dependency"].is_string())
+        {
+            response["error"] = "Edge spec needs \"dependent\" and \"dependency\" names: " + edgeSpec.dump();
+            return response;
+        }
+
+        auto dependentIter = jobIndices.find(edgeSpec["dependent"].get<std::string>());
+        auto dependencyIter = jobIndices.find(edgeSpec["dependency"].get<std::string>());
+        if ((dependentIter == jobIndices.end()) || (dependencyIter == jobIndices.end()))
+        {
+            response["error"] = "Edge refers to a job outside the graph: " + edgeSpec.dump();
+            return response;
+        }
+        if (dependentIter->second == dependencyIter->second)
+        {
+            response["error"] = "Job cannot depend on itself: " + dependentIter->first;
+            return response;
+        }
+
+        successors[dependencyIter->second].push_back(dependentIter->second);
+        ++pendingDependencies[dependentIter->second];
+    }
+
+    // A cycle would leave its jobs waiting forever, walk the graph in dependency order to find one
+    {
+        std::vector<int> remainingDependencies = pendingDependencies;
+        std::vector<size_t> readyJobs;
+        for (size_t i = 0; i < numJobs; ++i)
+        {
+            if (remainingDependencies[i] == 0)
+            {
+                readyJobs.push_back(i);
+            }
+        }
+
+        size_t numVisited = 0;
+        while (!readyJobs.empty())
+        {
+            size_t jobIndex = readyJobs.back();
+            readyJobs.pop_back();
+            ++numVisited;
+            for (size_t successorIndex : successors[jobIndex])
+            {
+                if (--remainingDependencies[successorIndex] == 0)
+                {
+                    readyJobs.push_back(successorIndex);
+                }
+            }
+        }
+
+        if (numVisited != numJobs)
+        {
+            response["error"] = "Graph has a dependency cycle";
+            return response;
+        }
+    }
+
+    // Create every job under a single factory lock
+    std::vector<Job *> jobs;
+    jobs.reserve(numJobs);
+    {
+        std::lock_guard<JobMutex> lockFactory(m_jobFactoriesMutex);
+        for (size_t i = 0; i < numJobs; ++i)
+        {
+            const std::string &jobType = jobSpecs[i]["type"].get_ref<const std::string &>();
+            auto factoryIter = m_jobFactories.find(jobType);
+            Job *job = (factoryIter != m_jobFactories.end()) ? factoryIter->second() : nullptr;
+            if (job == nullptr)
+            {
+                for (Job *createdJob : jobs)
+                {
+                    delete createdJob;
+                }
+                response["error"] = (factoryIter == m_jobFactories.end()) ? "Job type not registered: " + jobType
+                                                                          : "Failed to create job instance: " + jobType;
+                return response;
+            }
+
+            auto channelsIter = m_jobTypeChannels.find(jobType);
+            if (channelsIter != m_jobTypeChannels.end())
+            {
+                job->m_jobChannels = channelsIter->second;
+            }
+            auto retryPolicyIter = m_jobTypeRetryPolicies.find(jobType);
+            if (retryPolicyIter != m_jobTypeRetryPolicies.end())
+            {
+                job->m_retryPolicy = retryPolicyIter->second;
+            }
+            job->m_jobTypeName = jobType;
+            job->m_typeMetrics = GetJobTypeMetrics(jobType);
+            jobs.push_back(job);
+        }
+    }
+
+    // One block of IDs for the whole batch
+    JobID firstJobID = m_nextJobID.fetch_add((JobID)numJobs);
+    for (size_t i = 0; i < numJobs; ++i)
+    {
+        jobs[i]->m_jobID = firstJobID + (JobID)i;
+        jobs[i]->m_jobSystem = this;
+    }
+
+    // Nobody else can see the jobs yet, so they are wired up without taking their locks
+    nlohmann::json jobIDs = nlohmann::json::object();
+    JobTimeline::TimePoint queuedTime = JobTimeline::Now();
+    for (size_t i = 0; i < numJobs; ++i)
+    {
+        Job *job = jobs[i];
+        const nlohmann::json &jobSpec = jobSpecs[i];
+        if (jobSpec.contains("input"))
+        {
+            job->SetInput(jobSpec["input"]);
+            ReadSchedulingHints(job, jobSpec["input"]);
+        }
+        job->SetJobName(jobNames[i]);
+
+        for (size_t successorIndex : successors[i])
+        {
+            job->m_successorIDs.push_back(jobs[successorIndex]->m_jobID);
+        }
+        job->m_pendingDependencies.store(pendingDependencies[i]);
+        job->m_isQueued.store(true);
+        job->m_timeline.m_queuedTime = queuedTime;
+
+        jobIDs[jobNames[i]] = job->m_jobID;
+    }
+
+    // An empty batch gets a run ID but no run, nothing would ever finish it and let it go
+    if ((numJobs == 0) && !graphSpec.contains("runId"))
+    {
+        response["status"] = "Graph submitted";
+        response["runId"] = m_nextRunID.fetch_add(1);
+        response["jobIds"] = std::move(jobIDs);
+        return response;
+    }
+
+    // Publish the batch, then release the jobs with no dependencies onto the ready queues
+    JobRunID runID = graphSpec.contains("runId") ? graphSpec["runId"].get<JobRunID>() : CreateGraphRun();
+    {
+        std::lock_guard<JobMutex> lockGraphRuns(m_graphRunsMutex);
+        auto runIter = m_graphRuns.find(runID);
+        if ((runIter == m_graphRuns.end()) && (runID != DEFAULT_JOB_RUN_ID))
+        {
+            // Nobody can see the jobs yet, only their used up IDs have to be retired
+            for (Job *job : jobs)
+            {
+                m_jobHistory.RetireJob(job->m_jobID);
+                delete job;
+            }
+            response["error"] = "Graph run " + std::to_string(runID) + " was not created or has finished";
+            return response;
+        }
+
+        JobRunNames &runJobNames = m_graphRuns[runID];
+        for (size_t i = 0; i < numJobs; ++i)
+        {
+            jobs[i]->m_runID = runID;
+            runJobNames[jobNames[i]] = jobs[i]->m_jobID;
+        }
+    }
+    {
+        std::lock_guard<JobMutex> lockJobMap(m_jobsMutex);
+        m_jobs.reserve(m_jobs.size() + numJobs);
+        for (Job *job : jobs)
+        {
+            m_jobs[job->m_jobID] = job;
+        }
+    }
+    for (Job *job : jobs)
+    {
+        m_jobHistory.SetJobStatus(job->m_jobID, JOB_STATUS_QUEUED);
+    }
+
+    // Pick out the roots first, a released job can complete and free its successors right away
+    std::vector<Job *> rootJobs;
+    for (size_t i = 0; i < numJobs; ++i)
+    {
+        if (pendingDependencies[i] == 0)
+        {
+            rootJobs.push_back(jobs[i]);
+        }
+    }
+    std::vector<unsigned long> rootJobChannels;
+    for (Job *rootJob : rootJobs)
+    {
+        rootJobChannels.push_back(rootJob->m_jobChannels);
+        OnJobReleased(rootJob->m_jobChannels);
+    }
+    {
+        std::lock_guard<JobMutex> lockQueued(m_jobsQueuedMutex);
+        for (Job *rootJob : rootJobs)
+        {
+            rootJob->m_isReleased.store(true);
+            rootJob->m_timeline.m_releasedTime = queuedTime;
+            PushReadyJob(rootJob);
+        }
+    }
+    // One idle worker per root, graphs are usually all on the same channels
+    for (unsigned long jobChannels : rootJobChannels)
+    {
+        NotifyJobsAvailable(jobChannels);
+    }
+
+    response["status"] = "Graph submitted";
+    response["runId"] = runID;
+    response["jobIds"] = std::move(jobIDs);
+    return response;
+}
+
+void JobSystem::ReadSchedulingHints(Job *job, const nlohmann::json &input)
+{
+    if (!input.is_object())
+    {
+        return;
+    }
+
+    // "priority" is either a JobPriority value or its name
+    auto priorityIter = input.find("priority");
+    if (priorityIter != input.end())
+    {
+        if (priorityIter->is_number_integer())
+        {
+            job->SetPriority(priorityIter->get<int>());
+        }
+        else if (priorityIter->is_string())
+        {
+            const std::string &priorityName = priorityIter->get_ref<const std::string &>();
+            if (priorityName == "low")
+            {
+                job->SetPriority(JOB_PRIORITY_LOW);
+            }
+            else if (priorityName == "normal")
+            {
+                job->SetPriority(JOB_PRIORITY_NORMAL);
+            }
+            else if (priorityName == "high")
+            {
+                job->SetPriority(JOB_PRIORITY_HIGH);
+            }
+            else if (priorityName == "critical")
+            {
+                job->SetPriority(JOB_PRIORITY_CRITICAL);
+            }
+            else
+            {
+                std::cerr << "Unknown job priority: " << priorityName << std::endl;
+            }
+        }
+    }
+
+    // "deadlineMs" is relative to when the job is created
+    auto deadlineIter = input.find("deadlineMs");
+    if ((deadlineIter != input.end()) && deadlineIter->is_number())
+    {
+        job->SetDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(deadlineIter->get<long long>()));
+    }
+
+    // "timeoutMs" counts from when a worker claims the job
+    auto timeoutIter = input.find("timeoutMs");
+    if ((timeoutIter != input.end()) && timeoutIter->is_number())
+    {
+        job->SetTimeout(std::chrono::milliseconds(timeoutIter->get<long long>()));
+    }
+
+    // "retry" is either the maximum number of attempts or an object with "maxAttempts", "backoffMs",
+    // "maxBackoffMs", "jitter" and "retryableExitCodes", anything left out keeps the job type's policy
+    auto retryIter = input.find("retry");
+    if (retryIter != input.end())
+    {
+        JobRetryPolicy retryPolicy = job->GetRetryPolicy();
+        if (retryIter->is_number_integer())
+        {
+            retryPolicy.m_maxAttempts = retryIter->get<int>();
+        }
+        else if (retryIter->is_object())
+        {
+            retryPolicy.m_maxAttempts = retryIter->value("maxAttempts", retryPolicy.m_maxAttempts);
+            retryPolicy.m_initialBackoff = std::chrono::milliseconds(retryIter->value("backoffMs", (long long)retryPolicy.m_initialBackoff.count()));
+            retryPolicy.m_maxBackoff = std::chrono::milliseconds(retryIter->value("maxBackoffMs", (long long)retryPolicy.m_maxBackoff.count()));
+            retryPolicy.m_jitter = retryIter->value("jitter", retryPolicy.m_jitter);
+            auto exitCodesIter = retryIter->find("retryableExitCodes");
+            if ((exitCodesIter != retryIter->end()) && exitCodesIter->is_array())
+            {
+                retryPolicy.m_retryableExitCodes = exitCodesIter->get<std::vector<int>>();
+            }
+        }
+        else
+        {
+            std::cerr << "Ignoring retry hint, expected a number of attempts or an object: " << retryIter->dump() << std::endl;
+        }
+        job->SetRetryPolicy(retryPolicy);
+    }
+}
+
+std::string JobSystem::GetSchedulingHintsError(const nlohmann::json &input)
+{
+    // Only "retry" is read with conversions that throw on the wrong type, the other hints skip those
+    if (!input.is_object() || !input.contains("retry") || !input["retry"].is_object())
+    {
+        return std::string();
+    }
+
+    const nlohmann::json &retry = input["retry"];
+    for (const char *numberField : {"maxAttempts", "backoffMs", "maxBackoffMs", "jitter"})
+    {
+        if (retry.contains(numberField) && !retry[numberField].is_number())
+        {
+            return std::string("\"retry\" \"") + numberField + "\" must be a number";
+        }
+    }
+
+    auto exitCodesIter = retry.find("retryableExitCodes");
+    if (exitCodesIter != retry.end())
+    {
+        if (!exitCodesIter->is_array() ||
+            !std::all_of(exitCodesIter->begin(), exitCodesIter->end(), [](const nlohmann::json &exitCode)
+                         { return exitCode.is_number_integer(); }))
+        {
+            return "\"retry\" \"retryableExitCodes\" must be an array of integers";
+        }
+    }
+    return std::string();
+}
+
+void JobSystem::SetDependency(const std::string &dependentJobName, const std::string &dependencyJobName)
+{
+    SetDependency(DEFAULT_JOB_RUN_ID, dependentJobName, dependencyJobName);
+}
+
+JobID JobSystem::GetRunJobID(JobRunID runID, const std::string &jobName) const
+{
+    std::lock_guard<JobMutex> lockGraphRuns(m_graphRunsMutex);
+    auto runIter = m_graphRuns.find(runID);
+    if (runIter == m_graphRuns.end())
+    {
+        return INVALID_JOB_ID;
+    }
+    auto jobIDIter = runIter->second.find(jobName);
+    return (jobIDIter != runIter->second.end()) ? jobIDIter->second : INVALID_JOB_ID;
+}
+
+bool JobSystem::NameJob(Job *job, JobRunID runID, const std::string &jobName)
+{
+    // The default run is always open
+    std::lock_guard<JobMutex> lockGraphRuns(m_graphRunsMutex);
+    if ((runID != DEFAULT_JOB_RUN_ID) && (m_graphRuns.find(runID) == m_graphRuns.end()))
+    {
+        return false;
+    }
+
+    job->SetJobName(jobName);
+    job->m_runID = runID;
+
+    // A later job with the same name in the run takes the name over
+    m_graphRuns[runID][jobName] = job->m_jobID;
+    return true;
+}
+
+void JobSystem::ForgetJobName(const Job *job)
+{
+    std::lock_guard<JobMutex> lockGraphRuns(m_graphRunsMutex);
+    auto runIter = m_graphRuns.find(job->m_runID);
+    if (runIter == m_graphRuns.end())
+    {
+        return;
+    }
+
+    // Only if the name still belongs to this job and not to a newer one
+    JobRunNames &runJobNames = runIter->second;
+    auto jobIDIter = runJobNames.find(job->GetJobName());
+    if ((jobIDIter != runJobNames.end()) && (jobIDIter->second == job->m_jobID))
+    {
+        runJobNames.erase(jobIDIter);
+    }
+    if (runJobNames.empty() && (job->m_runID != DEFAULT_JOB_RUN_ID))
+    {
+        m_graphRuns.erase(runIter);
+    }
+}
+
+void JobSystem::SetDependency(JobRunID runID, const std::string &dependentJobName, const std::string &dependencyJobName)
+{
+    // Names only resolve within the run, two runs of the same graph never see each other's jobs
+    JobID dependentJobId = GetRunJobID(runID, dependentJobName);
+    JobID dependencyJobId = GetRunJobID(runID, dependencyJobName);
+    if ((dependentJobId == INVALID_JOB_ID) || (dependencyJobId == INVALID_JOB_ID))
+    {
+        std::cerr << "No job created yet in run " << runID << " for dependency: " << dependentJobName << " on "
+                  << dependencyJobName << std::endl;
+        return;
+    }
+
+    Job *dependentJob = GetJob(dependentJobId);
+    Job *dependencyJob = GetJob(dependencyJobId);
+    if ((dependentJob == nullptr) || (dependencyJob == nullptr))
+    {
+        std::cerr << "Dependency job no longer in JobSystem: " << dependentJobName << " on " << dependencyJobName << std::endl;
+        return;
+    }
+
+    if (dependentJob->m_isReleased.load())
+    {
+        std::cerr << "Job " << dependentJobName << " is already running, too late to depend on " << dependencyJobName << std::endl;
+        return;
+    }
+
+    AddSuccessor(dependencyJob, dependentJob);
+}
+
+bool JobSystem::AddSuccessor(Job *dependencyJob, Job *dependentJob)
+{
+    // Add the dependent to the dependency's successors, unless the dependency already completed
+    // in which case the dependent only needs its output. Returns whether the dependent has to wait
+    std::lock_guard<JobMutex> lockSuccessors(dependencyJob->m_successorsMutex);
+    if (dependencyJob->m_hasCompleted)
+    {
+        dependentJob->SetInput(dependencyJob->GetOutput());
+        return false;
+    }
+
+    dependentJob->m_pendingDependencies.fetch_add(1);
+    dependencyJob->m_successorIDs.push_back(dependentJob->m_jobID);
+    return true;
+}
+
+JobStatus JobSystem::GetJobStatus(JobID jobID) const
+{
+    return m_jobHistory.GetJobStatus(jobID);
+}
+
+bool JobSystem::IsJobComplete(JobID jobID) const
+{
+    JobStatus jobStatus = GetJobStatus(jobID);
+    return (jobStatus == JOB_STATUS_COMPLETED) || (jobStatus == JOB_STATUS_CANCELLED);
+}
+
+void JobSystem::SetCallbackMode(JobCallbackMode callbackMode)
+{
+    if (callbackMode == JOB_CALLBACK_THREAD)
+    {
+        std::lock_guard<JobMutex> lockCallbacks(m_callbacksMutex);
+        if (!m_callbackThread.joinable() && !m_isStoppingCallbacks)
+        {
+            m_callbackThread = std::thread(&JobSystem::CallbackThreadMain, this);
+        }
+    }
+
+    m_callbackMode.store(callbackMode);
+}
+
+void JobSystem::CallbackThreadMain()
+{
+    std::vector<Job *> callbackBatch;
+    while (true)
+    {
+        {
+            JobWaitLock lockCallbacks(m_callbacksMutex);
+            m_pendingCallbacksCondition.wait(lockCallbacks, [this]()
+                                             { return !m_pendingCallbacks.empty() || m_isStoppingCallbacks; });
+            if (m_pendingCallbacks.empty())
+            {
+                return;
+            }
+
+            // Everything that piled up while the last batch ran, one lock round trip for all of it
+            callbackBatch.swap(m_pendingCallbacks);
+        }
+
+        for (Job *job : callbackBatch)
+        {
+            RunJobCompleteCallback(job);
+            PublishJobCompleted(job, job->GetOutput());
+        }
+        callbackBatch.clear();
+    }
+}
+
+void JobSystem::StopCallbackThread()
+{
+    {
+        std::lock_guard<JobMutex> lockCallbacks(m_callbacksMutex);
+        m_isStoppingCallbacks = true;
+    }
+    m_pendingCallbacksCondition.notify_all();
+
+    if (m_callbackThread.joinable())
+    {
+        m_callbackThread.join();
+    }
+}
+
+void JobSystem::FinishCompletedJobs()
+{
+    // Creating a list for holding completed jobs
+    JobList jobsCompleted;
+    {
+        std::lock_guard<JobMutex> lockCompleted(m_jobsCompletedMutex);
+        jobsCompleted.swap(m_jobsCompleted);
+
+        // Retired jobs can no longer be looked up by ID
+        std::lock_guard<JobMutex> lockJobMap(m_jobsMutex);
+        for (Job *job : jobsCompleted)
+        {
+            m_jobs.erase(job->m_jobID);
+        }
+    }
+
+    // Iterating through jobs in jobsCompleted
+    // and calling each job's individual callback functions, unless they already ran
+    for (Job *job : jobsCompleted)
+    {
+        if (!job->m_hasRunCallback)
+        {
+            RunJobCompleteCallback(job);
+        }
+        RetireJob(job);
+    }
+}
+
+void JobSystem::RunJobCompleteCallback(Job *job)
+{
+    job->m_timeline.m_callbackStartTime = JobTimeline::Now();
+    job->JobCompleteCallback();
+    job->m_timeline.m_callbackEndTime = JobTimeline::Now();
+    job->m_hasRunCallback = true;
+}
+
+void JobSystem::RetireJob(Job *job)
+{
+    // Changing the status of the job in the job history
+    m_jobHistory.RetireJob(job->m_jobID);
+    job->m_timeline.m_retiredTime = JobTimeline::Now();
+    if (m_tracer.IsTracing())
+    {
+        TraceJob(job, job->IsCancelled() ? "cancelled" : "completed");
+    }
+
+    // Posted jobs have no name to give back
+    if (!job->GetJobName().empty())
+    {
+        ForgetJobName(job);
+    }
+    // A cancel still calling OnCancel() deletes it once done
+    ReleaseJobReference(job);
+}
+
+void JobSystem::TraceJob(const Job *job, const char *result)
+{
+    JobTraceRecord record;
+    record.m_jobID = job->m_jobID;
+    record.m_runID = job->m_runID;
+    record.m_jobType = job->m_jobTypeName;
+    record.m_jobName = job->GetJobName();
+    record.m_attempt = job->m_attempt.load();
+    record.m_result = result;
+    record.m_timeline = job->m_timeline;
+    m_tracer.Record(std::move(record));
+}
+
+void JobSystem::StartTrace(size_t maxJobs)
+{
+    m_tracer.Start(maxJobs);
+}
+
+void JobSystem::StopTrace()
+{
+    m_tracer.Stop();
+}
+
+nlohmann::json JobSystem::ExportTrace() const
+{
+    return m_tracer.ExportChromeTrace();
+}
+
+JobTypeMetrics *JobSystem::GetJobTypeMetrics(const std::string &jobType)
+{
+    std::unique_ptr<JobTypeMetrics> &jobTypeMetrics = m_jobTypeMetrics[jobType];
+    if (!jobTypeMetrics)
+    {
+        jobTypeMetrics = std::make_unique<JobTypeMetrics>();
+    }
+    return jobTypeMetrics.get();
+}
+
+nlohmann::json JobSystem::GetMetrics()
+{
+    nlohmann::json metrics;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    metrics["uptimeMs"] = std::chrono::duration<double, std::milli>(now - m_metricsStartTime).count();
+
+    // Ready queues by channel mask, jobs on a worker's local queue are counted with the worker
+    nlohmann::json readyQueues = nlohmann::json::array();
+    size_t numReadyJobs = 0;
+    {
+        std::lock_guard<JobMutex> lockQueued(m_jobsQueuedMutex);
+        for (int i = 0; i < m_numChannelQueues; ++i)
+        {
+            nlohmann::json readyQueue;
+            readyQueue["channels"] = m_channelQueues[i].m_jobChannels;
+            readyQueue["depth"] = m_channelQueues[i].m_jobs.size();
+            numReadyJobs += m_channelQueues[i].m_jobs.size();
+            readyQueues.push_back(std::move(readyQueue));
+        }
+    }
+    metrics["readyQueues"] = std::move(readyQueues);
+    {
+        // Runs with jobs that are not finished yet, and runs from CreateGraphRun() still waiting for theirs
+        std::lock_guard<JobMutex> lockGraphRuns(m_graphRunsMutex);
+        metrics["graphRuns"] = m_graphRuns.size();
+    }
+
+    nlohmann::json workers = nlohmann::json::array();
+    {
+        std::lock_guard<JobMutex> lock(m_workerThreadMutex);
+        for (JobWorkerThread *worker : m_workerThreads)
+        {
+            double busyMs = worker->m_busyNanoseconds.load(std::memory_order_relaxed) / 1.0e6;
+            double idleMs = worker->m_idleNanoseconds.load(std::memory_order_relaxed) / 1.0e6;
+            size_t localQueueDepth = worker->m_localQueue->GetSize();
+            numReadyJobs += localQueueDepth;
+
+            nlohmann::json workerMetrics;
+            workerMetrics["name"] = worker->m_uniqueName;
+            workerMetrics["channels"] = worker->GetWorkerJobChannels();
+            workerMetrics["busyMs"] = busyMs;
+            workerMetrics["idleMs"] = idleMs;
+            // Of the time the worker was either running jobs or asleep, looking for work counts as neither
+            workerMetrics["utilization"] = (busyMs + idleMs > 0.0) ? busyMs / (busyMs + idleMs) : 0.0;
+            workerMetrics["jobsExecuted"] = worker->m_numJobsExecuted.load(std::memory_order_relaxed);
+            workerMetrics["localQueueDepth"] = localQueueDepth;
+            workers.push_back(std::move(workerMetrics));
+        }
+    }
+    metrics["workers"] = std::move(workers);
+
+    {
+        std::lock_guard<JobMutex> lockRunning(m_jobsRunningMutex);
+        metrics["runningJobs"] = m_jobsRunning.size();
+    }
+    {
+        std::lock_guard<JobMutex> lockJobMap(m_jobsMutex);
+        metrics["jobsInSystem"] = m_jobs.size();
+    }
+    metrics["readyJobs"] = numReadyJobs;
+
+    unsigned long long numCompleted = 0;
+    nlohmann::json jobTypes = nlohmann::json::object();
+    {
+        std::lock_guard<JobMutex> lockJobFactory(m_jobFactoriesMutex);
+        for (const auto &jobTypeMetrics : m_jobTypeMetrics)
+        {
+            numCompleted += jobTypeMetrics.second->m_numCompleted.load(std::memory_order_relaxed) +
+                            jobTypeMetrics.second->m_numCancelled.load(std::memory_order_relaxed);
+            jobTypes[jobTypeMetrics.first] = jobTypeMetrics.second->ToJson();
+        }
+    }
+    metrics["jobTypes"] = std::move(jobTypes);
+
+    // Throughput over the time since the last snapshot, so polling shows the current rate
+    {
+        std::lock_guard<JobMutex> lockMetrics(m_metricsMutex);
+        double intervalSeconds = std::chrono::duration<double>(now - m_lastMetricsTime).count();
+        metrics["completedJobs"] = numCompleted;
+        // A snapshot racing this one may have counted a few more completions already
+        unsigned long long intervalCompleted = (numCompleted > m_lastMetricsCompleted) ? numCompleted - m_lastMetricsCompleted : 0;
+        metrics["jobsPerSecond"] = (intervalSeconds > 0.0) ? (double)intervalCompleted / intervalSeconds : 0.0;
+        m_lastMetricsTime = now;
+        m_lastMetricsCompleted = std::max(m_lastMetricsCompleted, numCompleted);
+    }
+
+#ifdef JOBSYSTEM_PROFILE_LOCKS
+    metrics["locks"] = JobLockProfiler::GetReport()["locks"];
+#endif
+    return metrics;
+}
+
+JobHandle JobSystem::Post(std::function<void()> work, unsigned long jobChannels)
+{
+    Job *job = new PostedJob(std::move(work), jobChannels);
+    job->m_jobID = m_nextJobID.fetch_add(1);
+    job->m_jobSystem = this;
+    job->m_isAutoRetired = true;
+    job->m_jobTypeName = "post";
+    job->m_typeMetrics = m_postedJobMetrics;
+    JobHandle jobHandle(job->m_jobID, job->m_completionState);
+
+    {
+        // Kept in the map only so a shutdown with the job still queued can delete it
+        std::lock_guard<JobMutex> lockMap(m_jobsMutex);
+        m_jobs[job->m_jobID] = job;
+    }
+
+    MarkJobQueued(job);
+    ReleaseJob(job);
+    return jobHandle;
+}
+
+// Shared by the caller of ParallelFor and the helpers it posts. A helper may only start after the call
+// has returned, so it holds the state alive but never touches the body without claiming a chunk first
+struct ParallelForState
+{
+    std::atomic<size_t> m_nextIndex{0};
+    size_t m_end = 0;
+    size_t m_grainSize = 1;
+    size_t m_numParticipants = 1;
+    const std::function<void(size_t, size_t)> *m_body = nullptr;
+
+    // Participants trying to claim or running a chunk, the caller returns once it drops to zero
+    std::atomic<int> m_numActive{0};
+    std::atomic<bool> m_hasFailed{false};
+    std::exception_ptr m_failure;
+    std::mutex m_mutex;
+    std::condition_variable m_idleCondition;
+};
+
+static bool ClaimParallelChunk(ParallelForState &state, size_t &chunkBegin, size_t &chunkEnd)
+{
+    size_t nextIndex = state.m_nextIndex.load();
+    while ((nextIndex < state.m_end) && !state.m_hasFailed.load())
+    {
+        // Half of an even share of what is left, never less than the grain
+        size_t remaining = state.m_end - nextIndex;
+        size_t chunkSize = std::min(remaining, std::max(state.m_grainSize, remaining / (2 * state.m_numParticipants)));
+        if (state.m_nextIndex.compare_exchange_weak(nextIndex, nextIndex + chunkSize))
+        {
+            chunkBegin = nextIndex;
+            chunkEnd = nextIndex + chunkSize;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void RunParallelChunks(ParallelForState &state)
+{
+    // Counted active before claiming, so the caller cannot see zero while we are about to run a chunk
+    state.m_numActive.fetch_add(1);
+
+    size_t chunkBegin = 0;
+    size_t chunkEnd = 0;
+    while (ClaimParallelChunk(state, chunkBegin, chunkEnd))
+    {
+        try
+        {
+            (*state.m_body)(chunkBegin, chunkEnd);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(state.m_mutex);
+            if (!state.m_hasFailed.exchange(true))
+            {
+                state.m_failure = std::current_exception();
+            }
+        }
+    }
+
+    if (state.m_numActive.fetch_sub(1) == 1)
+    {
+        std::lock_guard<std::mutex> lock(state.m_mutex);
+        state.m_idleCondition.notify_all();
+    }
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)> &body,
+                            unsigned long jobChannels)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    size_t numChunks = (end - begin + grainSize - 1) / grainSize;
+    size_t numHelpers = std::min(numChunks - 1, (size_t)GetNumWorkers(jobChannels));
+
+    // Not worth a helper, or nobody to help
+    if (numHelpers == 0)
+    {
+        body(begin, end);
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>();
+    state->m_nextIndex.store(begin);
+    state->m_end = end;
+    state->m_grainSize = grainSize;
+    state->m_numParticipants = numHelpers + 1;
+    state->m_body = &body;
+
+    for (size_t i = 0; i < numHelpers; ++i)
+    {
+        Post([state]()
+             { RunParallelChunks(*state); },
+             jobChannels);
+    }
+
+    // Help instead of waiting, then wait only for the chunks other participants are still running
+    RunParallelChunks(*state);
+    {
+        std::unique_lock<std::mutex> lock(state->m_mutex);
+        state->m_idleCondition.wait(lock, [&state]()
+                                    { return state->m_numActive.load() == 0; });
+    }
+
+    if (state->m_failure)
+    {
+        std::rethrow_exception(state->m_failure);
+    }
+}
+
+int JobSystem::GetNumWorkers(unsigned long jobChannels) const
+{
+    std::lock_guard<JobMutex> lock(m_workerThreadMutex);
+    int numWorkers = 0;
+    for (const JobWorkerThread *workerThread : m_workerThreads)
+    {
+        if ((workerThread->GetWorkerJobChannels() & jobChannels) != 0)
+        {
+            ++numWorkers;
+        }
+    }
+    return numWorkers;
+}
+
+nlohmann::json JobSystem::FinishJob(JobID jobID)
+{
+    JobHandle jobHandle = GetJobHandle(jobID);
+    if (!jobHandle.IsValid())
+    {
+        nlohmann::json response;
+        response["status"] = "error";
+        response["message"] = "Waiting for Job(#:" + std::to_string(jobID) + ") - no such job in JobSystem!";
+        return response;
+    }
+
+    return FinishJob(jobHandle);
+}
+
+nlohmann::json JobSystem::FinishJob(const JobHandle &jobHandle)
+{
+    nlohmann::json response;
+    JobID jobID = jobHandle.GetJobID();
+
+    // Checking the handle before finishing the job
+    if (!jobHandle.IsValid())
+    {
+        response["status"] = "error";
+        response["message"] = "Waiting for Job(#:" + std::to_string(jobID) + ") - no such job in JobSystem!";
+        return response;
+    }
+
+    // Sleeps until the worker signals completion, the job is on the completed list by then
+    jobHandle.Wait();
+
+    // Take the job off the completed list through its stored position
+    Job *thisCompletedJob = nullptr;
+    {
+        std::lock_guard<JobMutex> lockCompleted(m_jobsCompletedMutex);
+        std::lock_guard<JobMutex> lockJobMap(m_jobsMutex);
+        auto jobIter = m_jobs.find(jobID);
+        if (jobIter != m_jobs.end())
+        {
+            thisCompletedJob = jobIter->second;
+            m_jobs.erase(jobIter);
+            m_jobsCompleted.erase(thisCompletedJob->m_completedIter);
+        }
+    }
+
+    if (thisCompletedJob == nullptr)
+    {
+        response["status"] = "error";
+        response["message"] = "Job #" + std::to_string(jobID) + " was already finished";
+        return response;
+    }
+
+    // Call the job's callback function, unless it already ran on a worker or the callback thread
+    if (!thisCompletedJob->m_hasRunCallback)
+    {
+        RunJobCompleteCallback(thisCompletedJob);
+    }
+
+    // Where the job spent its time, taken before the job is deleted. Retried jobs only have the
+    // timeline of their last attempt, created is still when the first one was
+    response["jobType"] = thisCompletedJob->m_jobTypeName;
+    response["attempt"] = thisCompletedJob->m_attempt.load();
+    response["timeline"] = thisCompletedJob->m_timeline.ToJson();
+
+    // Change the status of the job in the job history and handle the memory for the job
+    RetireJob(thisCompletedJob);
+
+    // If we reach this point, it means the job has been successfully finished
+    response["status"] = "success";
+    response["message"] = "Job #" + std::to_string(jobID) + " finished successfully";
+    return response;
+}
+
+JobReactor &JobSystem::GetReactor()
+{
+    JobReactor *reactor = m_reactorInstance.load();
+    if (reactor != nullptr)
+    {
+        return *reactor;
+    }
+
+    std::lock_guard<JobMutex> lockReactor(m_reactorMutex);
+    if (!m_reactor)
+    {
+        m_reactor = std::make_unique<JobReactor>();
+        m_reactorInstance.store(m_reactor.get());
+    }
+    return *m_reactor;
+}
+
+void JobSystem::OnJobExecuted(Job *jobJustExecuted)
+{
+    // The job no longer needs an elastic worker, even if it completes later
+    int numElasticPools = m_numElasticPools.load();
+    for (int i = 0; i < numElasticPools; ++i)
+    {
+        if ((jobJustExecuted->m_jobChannels & m_elasticPools[i].m_jobChannels) != 0)
+        {
+            m_elasticPools[i].m_numActiveJobs.fetch_sub(1);
+        }
+    }
+
+    // A job that deferred its completion is parked until CompleteDeferred(), unless that already happened
+    int deferredCompletion = Job::DEFERRED_COMPLETION_PENDING;
+    if (jobJustExecuted->m_deferredCompletion.compare_exchange_strong(deferredCompletion, Job::DEFERRED_COMPLETION_PARKED))
+    {
+        return;
+    }
+
+    OnJobCompleted(jobJustExecuted);
+}
+
+void JobSystem::OnJobCompleted(Job *jobJustExecuted)
+{
+    // A failed attempt the retry policy covers is not a completion, nothing downstream hears about it
+    if (ScheduleRetry(jobJustExecuted))
+    {
+        return;
+    }
+    jobJustExecuted->m_timeline.m_completedTime = JobTimeline::Now();
+    if (jobJustExecuted->m_typeMetrics != nullptr)
+    {
+        jobJustExecuted->m_typeMetrics->RecordAttempt(jobJustExecuted->m_timeline, false, jobJustExecuted->IsCancelled(), jobJustExecuted->m_exitCode);
+    }
+
+    // Take the successor list, after this point SetDependency treats the job as done
+    std::vector<JobID> successorIDs;
+    {
+        std::lock_guard<JobMutex> lockSuccessors(jobJustExecuted->m_successorsMutex);
+        jobJustExecuted->m_hasCompleted = true;
+        successorIDs.swap(jobJustExecuted->m_successorIDs);
+    }
+
+    // Getting output from previous job to set as input for next, every successor shares the same payload
+    Job::Payload output = jobJustExecuted->GetOutput();
+
+    // Only this job's successors are touched, each one is released when its last dependency completes
+    for (JobID successorID : successorIDs)
+    {
+        Job *successorJob = GetJob(successorID);
+        if (successorJob == nullptr)
+        {
+            continue;
+        }
+
+        // Dependents added after the job was cancelled have not heard about it yet
+        if (jobJustExecuted->IsCancelled())
+        {
+            CancelJob(successorID, "dependency cancelled");
+        }
+
+        successorJob->SetInput(output);
+        if (successorJob->m_pendingDependencies.fetch_sub(1) == 1)
+        {
+            ReleaseJob(successorJob);
+        }
+    }
+
+    // Nobody finishes a posted job, it goes straight from running to retired
+    if (jobJustExecuted->m_isAutoRetired)
+    {
+        std::shared_ptr<JobCompletionState> completionState = jobJustExecuted->m_completionState;
+        {
+            std::lock_guard<JobMutex> lockRunning(m_jobsRunningMutex);
+            EraseRunningJob(jobJustExecuted);
+        }
+        {
+            std::lock_guard<JobMutex> lockMap(m_jobsMutex);
+            m_jobs.erase(jobJustExecuted->m_jobID);
+        }
+        RetireJob(jobJustExecuted);
+
+        JobHandle::SignalCompleted(completionState, output);
+        return;
+    }
+
+    // The callback runs before the job is published, so whoever waits on the handle sees its effects
+    switch (m_callbackMode.load())
+    {
+    case JOB_CALLBACK_INLINE:
+        RunJobCompleteCallback(jobJustExecuted);
+        break;
+    case JOB_CALLBACK_THREAD:
+    {
+        {
+            std::lock_guard<JobMutex> lockCallbacks(m_callbacksMutex);
+            m_pendingCallbacks.push_back(jobJustExecuted);
+        }
+        m_pendingCallbacksCondition.notify_one();
+        return;
+    }
+    default:
+        break;
+    }
+
+    PublishJobCompleted(jobJustExecuted, output);
+}
+
+bool JobSystem::EraseRunningJob(Job *job)
+{
+    if (!job->m_isRunning)
+    {
+        return false;
+    }
+    m_jobsRunning.erase(job->m_runningIter);
+    job->m_isRunning = false;
+    return true;
+}
+
+bool JobSystem::ScheduleRetry(Job *job)
+{
+    int failedAttempt = job->m_attempt.load();
+    if (job->IsCancelled() || (failedAttempt >= job->m_retryPolicy.m_maxAttempts) || !job->m_retryPolicy.IsRetryable(job->m_exitCode))
+    {
+        return false;
+    }
+
+    std::chrono::milliseconds backoff = GetRetryBackoff(job->m_retryPolicy, failedAttempt);
+    std::cerr << "Job " << job->m_jobID << " failed with exit code " << job->m_exitCode << " on attempt " << failedAttempt
+              << " of " << job->m_retryPolicy.m_maxAttempts << ", retrying in " << backoff.count() << "ms" << std::endl;
+
+    {
+        std::lock_guard<JobMutex> lockRunning(m_jobsRunningMutex);
+        EraseRunningJob(job);
+    }
+
+    // The failed attempt is traced on its own, the next one starts a fresh timeline
+    job->m_timeline.m_completedTime = JobTimeline::Now();
+    if (job->m_typeMetrics != nullptr)
+    {
+        job->m_typeMetrics->RecordAttempt(job->m_timeline, true, false, job->m_exitCode);
+    }
+    if (m_tracer.IsTracing())
+    {
+        TraceJob(job, "retried");
+    }
+    JobTimeline::TimePoint createdTime = job->m_timeline.m_createdTime;
+    job->m_timeline = JobTimeline();
+    job->m_timeline.m_createdTime = createdTime;
+    job->m_timeline.m_queuedTime = JobTimeline::Now();
+
+    // Back to the state QueueJob leaves it in, the attempt goes up first so old timeouts no longer match
+    job->m_attempt.store(failedAttempt + 1);
+    job->m_exitCode = 0;
+    job->m_deferredCompletion.store(Job::DEFERRED_COMPLETION_NONE);
+    job->m_isReleased.store(false);
+    m_jobHistory.SetJobStatus(job->m_jobID, JOB_STATUS_QUEUED);
+
+    // Nothing can delete the job before it completes, and a cancel while it waits only means it is
+    // completed without running once it is released
+    GetReactor().AddTimer(std::chrono::steady_clock::now() + backoff, [this, job]()
+                          { ReleaseJob(job); });
+    return true;
+}
+
+std::chrono::milliseconds JobSystem::GetRetryBackoff(const JobRetryPolicy &retryPolicy, int failedAttempt)
+{
+    double backoffMs = (double)retryPolicy.m_initialBackoff.count() * std::pow(retryPolicy.m_backoffMultiplier, failedAttempt - 1);
+    backoffMs = std::min(backoffMs, (double)retryPolicy.m_maxBackoff.count());
+
+    if (retryPolicy.m_jitter > 0.0)
+    {
+        thread_local std::minstd_rand s_jitterRandom(std::random_device{}());
+        std::uniform_real_distribution<double> jitterDistribution(-retryPolicy.m_jitter, retryPolicy.m_jitter);
+        backoffMs *= 1.0 + jitterDistribution(s_jitterRandom);
+    }
+    return std::chrono::milliseconds((long long)std::max(0.0, backoffMs));
+}
+
+void JobSystem::PublishJobCompleted(Job *job, const Job::Payload &output)
+{
+    // Keep the completion event alive on our own, the job may be deleted once it is published
+    std::shared_ptr<JobCompletionState> completionState = job->m_completionState;
+
+    // Publish the job as completed last, once it is on the completed list the main thread may delete it
+    {
+        // Protect the jobCompleted and jobRunning deques
+        std::lock_guard<JobMutex> lockCompleted(m_jobsCompletedMutex);
+        std::lock_guard<JobMutex> lockRunning(m_jobsRunningMutex);
+
+        // Remove the job from the running list
+        if (!EraseRunningJob(job))
+        {
+            // Never claimed or already published, it has no place on the completed list for
+            // FinishJob to take it off, so it is not published at all
+            std::cerr << "Job ID: " << job->GetUniqueID() << " not found in the running jobs." << std::endl;
+            return;
+        }
+
+        // Add the job to the jobs completed list and remember where it went
+        job->m_completedIter = m_jobsCompleted.insert(m_jobsCompleted.end(), job);
+        // Changed the status of the job in the job history
+        m_jobHistory.SetJobStatus(job->m_jobID, job->IsCancelled() ? JOB_STATUS_CANCELLED : JOB_STATUS_COMPLETED);
+    }
+
+    // Wake anyone waiting on the job and run its continuations
+    JobHandle::SignalCompleted(completionState, output);
+}
+
+Job *JobSystem::ClaimAJob(JobWorkerThread *worker, unsigned long workerJobChannels)
+{
+    // Prioritized jobs only ever wait in the global queues, look there first while any are waiting,
+    // or when a job there has aged past an aging step and would be overtaken by our local work
+    Job *claimedJob = nullptr;
+    bool checkedReadyQueues = false;
+    long long agedScheduleKey = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    (std::chrono::steady_clock::now() - JOB_PRIORITY_AGING_STEP).time_since_epoch())
+                                    .count();
+    if ((m_numPrioritizedReadyJobs.load() > 0) || (m_oldestReadyScheduleKey.load() < agedScheduleKey))
+    {
+        std::lock_guard<JobMutex> lockQueued(m_jobsQueuedMutex);
+        claimedJob = PopReadyJob(worker, workerJobChannels);
+        checkedReadyQueues = true;
+    }
+
+    // Then our own local queue, no other worker touches it unless it is stealing
+    if (claimedJob == nullptr)
+    {
+        claimedJob = worker->m_localQueue->PopJob();
+    }
+
+    if ((claimedJob == nullptr) && !checkedReadyQueues)
+    {
+        // Protect the global ready queues
+        std::lock_guard<JobMutex> lockQueued(m_jobsQueuedMutex);
+        claimedJob = PopReadyJob(worker, workerJobChannels);
+    }
+
+    if (claimedJob == nullptr)
+    {
+        claimedJob = StealAJob(worker, workerJobChannels);
+    }
+
+    if (claimedJob != nullptr)
+    {
+        {
+            // Add the job to the running jobs list and remember where it went
+            std::lock_guard<JobMutex> lockRunning(m_jobsRunningMutex);
+            claimedJob->m_runningIter = m_jobsRunning.insert(m_jobsRunning.end(), claimedJob);
+            claimedJob->m_isRunning = true;
+        }
+
+        // Change the job status of the job in the job history
+        m_jobHistory.SetJobStatus(claimedJob->m_jobID, JOB_STATUS_RUNNING);
+        claimedJob->m_timeline.m_claimedTime = JobTimeline::Now();
+        claimedJob->m_timeline.m_workerIndex = worker->m_workerIndex;
+
+        // The timeout cancels by ID, so it does nothing if the job has completed and been finished by then
+        if ((claimedJob->m_timeout.count() > 0) && !claimedJob->IsCancelled())
+        {
+            JobID timedJobID = claimedJob->m_jobID;
+            int timedAttempt = claimedJob->m_attempt.load();
+            GetReactor().AddTimer(std::chrono::steady_clock::now() + claimedJob->m_timeout, [this, timedJobID, timedAttempt]()
+                                  { CancelJobAttempt(timedJobID, "timed out", timedAttempt); });
+        }
+    }
+
+    return claimedJob;
+}
+
+int JobSystem::GetChannelQueueIndex(unsigned long jobChannels)
+{
+    for (int i = 0; i < m_numChannelQueues; ++i)
+    {
+        if (m_channelQueues[i].m_jobChannels == jobChannels)
+        {
+            return i;
+        }
+    }
+
+    // First time we see this mask, give it a queue of its own while there are any left
+    if (m_numChannelQueues < MAX_JOB_CHANNEL_QUEUES - 1)
+    {
+        int queueIndex = m_numChannelQueues++;
+        m_channelQueues[queueIndex].m_jobChannels = jobChannels;
+        ++m_channelQueuesGeneration;
+        return queueIndex;
+    }
+
+    // Out of queues, the shared overflow queue accepts every channel
+    if (m_numChannelQueues == MAX_JOB_CHANNEL_QUEUES - 1)
+    {
+        m_numChannelQueues = MAX_JOB_CHANNEL_QUEUES;
+        m_channelQueues[MAX_JOB_CHANNEL_QUEUES - 1].m_jobChannels = ~0UL;
+        ++m_channelQueuesGeneration;
+    }
+    return MAX_JOB_CHANNEL_QUEUES - 1;
+}
+
+bool JobSystem::IsPrioritizedJob(const Job *job)
+{
+    // Low priority jobs must not pull workers away from their normal local work
+    return (job->m_priority > JOB_PRIORITY_NORMAL) || job->HasDeadline();
+}
+
+bool JobSystem::IsScheduledJob(const Job *job)
+{
+    return (job->m_priority != JOB_PRIORITY_NORMAL) || job->HasDeadline();
+}
+
+bool JobSystem::RunsAfter(const Job *lhs, const Job *rhs)
+{
+    // Heap ordering, the lowest key runs first and equal keys run in the order they were pushed
+    if (lhs->m_scheduleKey != rhs->m_scheduleKey)
+    {
+        return lhs->m_scheduleKey > rhs->m_scheduleKey;
+    }
+    return lhs->m_readySequence > rhs->m_readySequence;
+}
+
+void JobSystem::PushReadyJob(Job *job)
+{
+    std::chrono::steady_clock::time_point scheduleTime = std::chrono::steady_clock::now() - JOB_PRIORITY_AGING_STEP * job->m_priority;
+    if (job->HasDeadline())
+    {
+        scheduleTime = std::min(scheduleTime, job->m_deadline - JOB_DEADLINE_HORIZON);
+    }
+    job->m_scheduleKey = std::chrono::duration_cast<std::chrono::nanoseconds>(scheduleTime.time_since_epoch()).count();
+    job->m_readySequence = m_nextReadySequence++;
+
+    int queueIndex = GetChannelQueueIndex(job->m_jobChannels);
+    std::vector<Job *> &readyJobs = m_channelQueues[queueIndex].m_jobs;
+    readyJobs.push_back(job);
+    std::push_heap(readyJobs.begin(), readyJobs.end(), RunsAfter);
+    m_nonEmptyChannelQueues |= (1ULL << queueIndex);
+
+    if (IsPrioritizedJob(job))
+    {
+        m_numPrioritizedReadyJobs.fetch_add(1);
+    }
+    if (job->m_scheduleKey < m_oldestReadyScheduleKey.load())
+    {
+        m_oldestReadyScheduleKey.store(job->m_scheduleKey);
+    }
+}
+
+Job *JobSystem::PopReadyJob(JobWorkerThread *worker, unsigned long workerJobChannels)
+{
+    // Rebuild the worker's queue mask only when a new channel mask showed up or its channels changed
+    if ((worker->m_channelQueueMaskGeneration != m_channelQueuesGeneration) ||
+        (worker->m_channelQueueMaskChannels != workerJobChannels))
+    {
+        worker->m_channelQueueMask = 0;
+        for (int i = 0; i < m_numChannelQueues; ++i)
+        {
+            if ((m_channelQueues[i].m_jobChannels & workerJobChannels) != 0)
+            {
+                worker->m_channelQueueMask |= (1ULL << i);
+            }
+        }
+        worker->m_channelQueueMaskChannels = workerJobChannels;
+        worker->m_channelQueueMaskGeneration = m_channelQueuesGeneration;
+    }
+
+    // Every ready queue this worker can serve offers its front job, the lowest key across them wins
+    unsigned long long readyQueues = m_nonEmptyChannelQueues & worker->m_channelQueueMask;
+    Job *readyJob = nullptr;
+    int readyQueueIndex = -1;
+    size_t readyJobIndex = 0;
+    while (readyQueues != 0)
+    {
+        int queueIndex = __builtin_ctzll(readyQueues);
+        readyQueues &= readyQueues - 1;
+
+        const std::vector<Job *> &readyJobs = m_channelQueues[queueIndex].m_jobs;
+        size_t jobIndex = 0;
+        if (queueIndex == MAX_JOB_CHANNEL_QUEUES - 1)
+        {
+            // The overflow queue mixes masks, find the best job this worker may run
+            jobIndex = readyJobs.size();
+            for (size_t i = 0; i < readyJobs.size(); ++i)
+            {
+                if (((readyJobs[i]->m_jobChannels & workerJobChannels) != 0) &&
+                    ((jobIndex == readyJobs.size()) || RunsAfter(readyJobs[jobIndex], readyJobs[i])))
+                {
+                    jobIndex = i;
+                }
+            }
+            if (jobIndex == readyJobs.size())
+            {
+                continue;
+            }
+        }
+
+        if ((readyJob == nullptr) || RunsAfter(readyJob, readyJobs[jobIndex]))
+        {
+            readyJob = readyJobs[jobIndex];
+            readyQueueIndex = queueIndex;
+            readyJobIndex = jobIndex;
+        }
+    }
+
+    if (readyJob == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::vector<Job *> &readyJobs = m_channelQueues[readyQueueIndex].m_jobs;
+    if (readyJobIndex == 0)
+    {
+        std::pop_heap(readyJobs.begin(), readyJobs.end(), RunsAfter);
+        readyJobs.pop_back();
+    }
+    else
+    {
+        readyJobs.erase(readyJobs.begin() + readyJobIndex);
+        std::make_heap(readyJobs.begin(), readyJobs.end(), RunsAfter);
+    }
+
+    if (readyJobs.empty())
+    {
+        m_nonEmptyChannelQueues &= ~(1ULL << readyQueueIndex);
+    }
+
+    if (IsPrioritizedJob(readyJob))
+    {
+        m_numPrioritizedReadyJobs.fetch_sub(1);
+    }
+
+    // Each heap has its lowest key at the front, the overflow queue's included
+    long long oldestScheduleKey = LLONG_MAX;
+    unsigned long long nonEmptyQueues = m_nonEmptyChannelQueues;
+    while (nonEmptyQueues != 0)
+    {
+        int queueIndex = __builtin_ctzll(nonEmptyQueues);
+        nonEmptyQueues &= nonEmptyQueues - 1;
+        oldestScheduleKey = std::min(oldestScheduleKey, m_channelQueues[queueIndex].m_jobs.front()->m_scheduleKey);
+    }
+    m_oldestReadyScheduleKey.store(oldestScheduleKey);
+
+    return readyJob;
+}
+
+Job *JobSystem::StealAJob(JobWorkerThread *thief, unsigned long thiefJobChannels)
+{
+    std::shared_ptr<const std::vector<std::shared_ptr<JobWorkerQueue>>> workerQueues;
+    {
+        std::lock_guard<JobMutex> lock(m_workerQueuesMutex);
+        workerQueues = m_workerQueues;
+    }
+
+    if (!workerQueues || workerQueues->empty())
+    {
+        return nullptr;
+    }
+
+    // Start at a different victim on every attempt so thieves spread out
+    static thread_local size_t s_nextVictim = 0;
+    size_t numQueues = workerQueues->size();
+    size_t firstVictim = s_nextVictim++ % numQueues;
+
+    for (size_t i = 0; i < numQueues; ++i)
+    {
+        const std::shared_ptr<JobWorkerQueue> &victimQueue = (*workerQueues)[(firstVictim + i) % numQueues];
+        if (victimQueue == thief->m_localQueue)
+        {
+            continue;
+        }
+
+        Job *stolenJob = victimQueue->StealJob(thiefJobChannels);
+        if (stolenJob != nullptr)
+        {
+            return stolenJob;
+        }
+    }
+
+    return nullptr;
+}
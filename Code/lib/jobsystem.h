@@ -2,99 +2,371 @@
 #include <mutex>
 #include <map>
 #include <deque>
+#include <list>
 #include <vector>
 #include <thread>
 #include <functional>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <climits>
 #include <nlohmann/json.hpp>
+#include "jobhandle.h"
+#include "jobstatustable.h"
+#include "joballocator.h"
+#include "job.h"
+#include "jobtopology.h"
+#include "jobreactor.h"
+#include "jobmetrics.h"
+#include "jobmutex.h"
 
 constexpr int JOB_TYPE_ANY = -1;
 
 class JobWorkerThread;
+class JobWorkerQueue;
 
-enum JobStatus
+// Every distinct job channel mask gets its own ready queue, so a worker finds something it can
+// run by masking the non-empty bitmap with the queues that overlap its channels
+constexpr int MAX_JOB_CHANNEL_QUEUES = 64;
+
+// Ready queues are ordered by a key fixed when the job is pushed: the time it became ready, moved
+// back one aging step per priority level. Jobs that have waited longer compare as if they had a
+// higher priority, so aging needs no periodic rescoring
+constexpr std::chrono::milliseconds JOB_PRIORITY_AGING_STEP(250);
+// A job with a deadline is keyed as if it became ready this long before its deadline, so it
+// overtakes everything that became ready after that point
+constexpr std::chrono::milliseconds JOB_DEADLINE_HORIZON(1000);
+
+class Job;
+
+struct JobChannelQueue
 {
-    JOB_STATUS_NEVER_SEEN,
-    JOB_STATUS_QUEUED,
-    JOB_STATUS_RUNNING,
-    JOB_STATUS_COMPLETED,
-    JOB_STATUS_RETIRED,
-    NUM_JOB_STATUSES
+    unsigned long m_jobChannels = 0;
+    // Binary heap, the job to run next is at the front
+    std::vector<Job *> m_jobs;
 };
 
-struct JobHistoryEntry
+// Workers the job system starts and retires on demand for a set of channels. The pool grows while
+// more of its jobs are released and not yet completed than it has workers, up to the maximum, and
+// workers that sit idle for the timeout retire down to the minimum. Suited to jobs that spend most
+// of their time blocked, where a fixed pool would leave released jobs waiting behind sleeping ones
+struct JobElasticPool
 {
-    JobHistoryEntry(int jobType, JobStatus JobStatus) : m_jobType(jobType), m_jobStatus(JobStatus) {}
+    std::string m_namePrefix;
+    unsigned long m_jobChannels = 0;
+    int m_minWorkers = 0;
+    int m_maxWorkers = 0;
+    std::chrono::milliseconds m_idleTimeout{0};
 
-    int m_jobType = -1;
-    int m_jobStatus = JOB_STATUS_NEVER_SEEN;
+    // Released jobs on the pool's channels that have not completed yet
+    std::atomic<int> m_numActiveJobs{0};
+    // Only changed under the job system's worker thread lock
+    std::atomic<int> m_numWorkers{0};
+    int m_nextWorkerIndex = 0;
 };
 
-class Job;
+constexpr int MAX_JOB_ELASTIC_POOLS = 4;
+
+class JobSystem;
+
+// Handed to whoever may need to cancel a job later, without keeping the job or its ID around by hand.
+// Safe to use after the job finished, but not after its job system is destroyed
+class JobCancelToken
+{
+public:
+    JobCancelToken() = default;
+    JobCancelToken(JobSystem *jobSystem, JobID jobID) : m_jobSystem(jobSystem), m_jobID(jobID) {}
+
+    bool Cancel(const std::string &reason = "cancelled") const;
+    JobID GetJobID() const { return m_jobID; }
+    bool IsValid() const { return m_jobSystem != nullptr; }
+
+private:
+    JobSystem *m_jobSystem = nullptr;
+    JobID m_jobID = INVALID_JOB_ID;
+};
+
+// Where JobCompleteCallback() runs. Except for JOB_CALLBACK_ON_FINISH, the callback has run before the
+// job's handle completes, and successors are released before the callback either way
+enum JobCallbackMode
+{
+    JOB_CALLBACK_ON_FINISH = 0, // On the thread calling FinishJob(), or FinishCompletedJobs() for the whole batch
+    JOB_CALLBACK_INLINE,        // On the worker that completed the job
+    JOB_CALLBACK_THREAD,        // On a callback thread, which runs whatever has piled up in one batch
+};
 
 class JobSystem
 {
     friend class JobWorkerThread;
+    friend class Job;
 
 public:
     JobSystem();
     ~JobSystem();
 
-    static JobSystem *CreateOrGet();
-    static void Destroy();
-
-    void CreateWorkerThread(const char *uniqueName, unsigned long workerJobChannels = 0xFFFFFFFF);
+    void CreateWorkerThread(const char *uniqueName, unsigned long workerJobChannels = 0xFFFFFFFF,
+                            const JobWorkerPlacement &placement = JobWorkerPlacement());
     void DestroyWorkerThread(const char *uniqueName);
-    void QueueJob(int jobID);
+    bool CreateElasticWorkerPool(const std::string &namePrefix, unsigned long jobChannels, int minWorkers, int maxWorkers,
+                                 std::chrono::milliseconds idleTimeout);
+    JobHandle QueueJob(JobID jobID);
+
+    // Queues a job to start once another completes, with the other job's output as its input. The
+    // worker that completes the first job releases it, the thread that finishes jobs is not involved
+    JobHandle QueueJobAfter(JobID jobID, JobID previousJobID);
+
+    // Cancels a job that has not completed, and every job that depends on it. Queued jobs complete
+    // without running, running ones get OnCancel(), which stops a subprocess job's child.
+    // Returns false if the job is unknown, already complete or already cancelled
+    bool CancelJob(JobID jobID, const std::string &reason = "cancelled");
+    JobCancelToken GetCancelToken(JobID jobID);
+    JobHandle GetJobHandle(JobID jobID) const;
 
-    // Registering custom job
-    void RegisterJobType(const std::string &jobType, std::function<Job *()> jobFactory);
+    // Registering custom job, non-zero channels replace the ones the job type's constructor sets
+    void RegisterJobType(const std::string &jobType, std::function<Job *()> jobFactory, unsigned long jobChannels = 0);
 
+    // Every job of the type created from now on gets the policy, a "retry" input hint overrides it per job
+    void SetRetryPolicy(const std::string &jobType, const JobRetryPolicy &retryPolicy);
+
+    // Creates a job in the default run, named after its type
     nlohmann::json CreateJob(const std::string &jobType, nlohmann::json &input);
+
+    // A fresh run for jobs whose names must not collide with another run's, such as a second
+    // instance of the same graph. A run is forgotten once its last named job is finished, after that,
+    // like a run this never returned, it takes no more jobs
+    JobRunID CreateGraphRun();
+    // Forgets a run that has no jobs left, such as one that never got any. A run with jobs is
+    // forgotten once they are finished anyway
+    void CloseGraphRun(JobRunID runID);
+    // Creates a job named within the run, the name defaults to the type
+    nlohmann::json CreateJob(const std::string &jobType, nlohmann::json &input, JobRunID runID,
+                             const std::string &jobName = "");
+    // Same without building a JSON response or copying the input, for callers creating jobs at a high
+    // rate. Jobs can share one input payload. Returns INVALID_JOB_ID and fills in error on failure
+    JobID CreateJob(const std::string &jobType, Job::Payload input, JobRunID runID, const std::string &jobName,
+                    std::string &error);
+
+    // Creates, wires and queues a whole batch of jobs at once. The spec is
+    // {"jobs": [{"name", "type", "input"}], "edges": [{"dependent", "dependency"}]},
+    // "name" defaults to the type. Each submission gets a run of its own, returned as "runId",
+    // unless the spec names an open one from CreateGraphRun() with "runId". Nothing is created
+    // unless the entire batch is valid
+    nlohmann::json SubmitGraph(const nlohmann::json &graphSpec);
     nlohmann::json GetAJobStatus(const std::string &jobType);
 
     std::vector<std::string> GetAvailableJobTypes();
 
-    // Job dependency functions
+    // Job dependency functions, names are looked up in the default run unless one is given
     void SetDependency(const std::string &dependentJobName, const std::string &dependencyJobName);
+    void SetDependency(JobRunID runID, const std::string &dependentJobName, const std::string &dependencyJobName);
+    JobID GetRunJobID(JobRunID runID, const std::string &jobName) const;
 
     // Status Queries
-    JobStatus GetJobStatus(int jobID) const;
-    bool IsJobComplete(int jobID) const;
+    JobStatus GetJobStatus(JobID jobID) const;
+    bool IsJobComplete(JobID jobID) const;
+
+    // Shared reactor for jobs waiting on subprocesses, started the first time it is needed
+    JobReactor &GetReactor();
+
+    // The callback thread starts the first time it is chosen
+    void SetCallbackMode(JobCallbackMode callbackMode);
+
+    // Keeps the timelines of retired jobs, the newest maxJobs of them, until tracing is stopped
+    void StartTrace(size_t maxJobs = 100000);
+    void StopTrace();
+    // Chrome trace event JSON of every timeline kept so far, for chrome://tracing or ui.perfetto.dev
+    nlohmann::json ExportTrace() const;
+
+    // Snapshot of ready queue depths, running jobs, worker busy and idle time, throughput since the
+    // last snapshot, and queue wait and execution histograms per job type. Lock profiles are added in
+    // builds with JOBSYSTEM_PROFILE_LOCKS
+    nlohmann::json GetMetrics();
 
     void FinishCompletedJobs();
-    nlohmann::json FinishJob(int jobID);
+    nlohmann::json FinishJob(const JobHandle &jobHandle);
+    nlohmann::json FinishJob(JobID jobID);
+
+    // Runs work once on a worker serving the channels. The job is not named and retires itself when
+    // done, the handle is only needed to wait for it
+    JobHandle Post(std::function<void()> work, unsigned long jobChannels = JOB_CHANNEL_CPU);
+
+    // Calls body(chunkBegin, chunkEnd) over [begin, end) split across the workers serving the channels.
+    // Chunks start large and shrink towards the grain size as the range runs out, so participants finish
+    // together. The calling thread runs chunks too, which lets a job's Execute() use it without starving
+    // the pool. Returns once every chunk has run, rethrowing the first exception a chunk threw
+    void ParallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)> &body,
+                     unsigned long jobChannels = JOB_CHANNEL_CPU);
+
+    // ParallelFor that folds each chunk's result into one. Chunks finish in any order, so combine
+    // must be associative and commutative
+    template <typename T, typename ChunkFunction, typename CombineFunction>
+    T ParallelReduce(size_t begin, size_t end, size_t grainSize, T identity, ChunkFunction chunkFunction,
+                     CombineFunction combine, unsigned long jobChannels = JOB_CHANNEL_CPU)
+    {
+        T result = std::move(identity);
+        std::mutex resultMutex;
+        ParallelFor(
+            begin, end, grainSize, [&](size_t chunkBegin, size_t chunkEnd)
+            {
+                T chunkResult = chunkFunction(chunkBegin, chunkEnd);
+                std::lock_guard<std::mutex> lock(resultMutex);
+                result = combine(std::move(result), std::move(chunkResult)); },
+            jobChannels);
+        return result;
+    }
 
 private:
-    Job *ClaimAJob(unsigned long workerJobChannels);
+    Job *ClaimAJob(JobWorkerThread *worker, unsigned long workerJobChannels);
+    Job *StealAJob(JobWorkerThread *thief, unsigned long thiefJobChannels);
+    void RebuildWorkerQueues();
+
+    // Elastic pools, callers of the first two hold m_workerThreadMutex
+    void StartElasticWorker(JobElasticPool &elasticPool);
+    void ReapRetiredWorkers();
+    void OnJobReleased(unsigned long jobChannels);
+    bool RetireElasticWorker(JobWorkerThread *worker);
+    int GetNumWorkers(unsigned long jobChannels) const;
+
+    // Ready queues, callers hold m_jobsQueuedMutex
+    void PushReadyJob(Job *job);
+    Job *PopReadyJob(JobWorkerThread *worker, unsigned long workerJobChannels);
+    int GetChannelQueueIndex(unsigned long jobChannels);
+    // Jobs that run ahead of normal work, workers check the global queues first while any wait
+    static bool IsPrioritizedJob(const Job *job);
+    // Jobs whose priority or deadline only the global ready heaps honour, prioritized or low priority
+    static bool IsScheduledJob(const Job *job);
+    static bool RunsAfter(const Job *lhs, const Job *rhs);
+    static void ReadSchedulingHints(Job *job, const nlohmann::json &input);
+    // Why ReadSchedulingHints() could not read the input, empty if it can
+    static std::string GetSchedulingHintsError(const nlohmann::json &input);
+    void OnJobExecuted(Job *jobJustExecuted);
     void OnJobCompleted(Job *jobJustExecuted);
-    bool AreDependenciesResolved(int jobID);
+    void PublishJobCompleted(Job *job, const Job::Payload &output);
+    void SetCancelledOutput(Job *job);
+    // Only cancels while the job is on the given attempt, a retried job outlives its earlier timeouts
+    bool CancelJobAttempt(JobID jobID, const std::string &reason, int attempt);
+    // Cancels one job, adding its successors to cancelledSuccessorIDs for the caller to cancel next
+    bool CancelSingleJob(JobID jobID, const std::string &reason, int attempt, std::vector<JobID> &cancelledSuccessorIDs);
+    void ReleaseJobReference(Job *job);
+    bool ScheduleRetry(Job *job);
+    // Takes the job off the running list if it is on it, the caller holds m_jobsRunningMutex
+    bool EraseRunningJob(Job *job);
+    static std::chrono::milliseconds GetRetryBackoff(const JobRetryPolicy &retryPolicy, int failedAttempt);
+    void CallbackThreadMain();
+    void StopCallbackThread();
+    bool AddSuccessor(Job *dependencyJob, Job *dependentJob);
+    Job *GetJob(JobID jobID) const;
+    // Returns whether this call queued the job
+    bool MarkJobQueued(Job *job);
+    void RunJobCompleteCallback(Job *job);
+    // Deletes a job nobody can look up any more
+    void RetireJob(Job *job);
+    void TraceJob(const Job *job, const char *result);
+    // Callers hold m_jobFactoriesMutex
+    JobTypeMetrics *GetJobTypeMetrics(const std::string &jobType);
+    // False, leaving the job unnamed, if the run was never created or is already forgotten
+    bool NameJob(Job *job, JobRunID runID, const std::string &jobName);
+    void ForgetJobName(const Job *job);
+    void ReleaseJob(Job *job);
 
-    static JobSystem *s_jobSystem;
+    // Worker wakeup, a worker only goes idle if the generation has not moved past the one it saw,
+    // then sleeps until a job it can run is released. Returns false if an elastic worker's idle
+    // timeout ran out first
+    unsigned long long GetJobsAvailableGeneration() const;
+    bool WaitForJobsAvailable(unsigned long long seenGeneration, JobWorkerThread *worker, unsigned long workerJobChannels);
+    // Wakes one idle worker serving the channels, call it once per released job
+    void NotifyJobsAvailable(unsigned long jobChannels);
+    void WakeWorker(JobWorkerThread *worker);
+
+    // Each instance hands out its own IDs, so jobs can be created from any thread
+    std::atomic<JobID> m_nextJobID{0};
 
     std::map<std::string, std::function<Job *()>> m_jobFactories;
-    mutable std::mutex m_jobFactoriesMutex;
-    std::map<int, std::vector<int>> m_jobDependencies;
-    mutable std::mutex m_jobDependenciesMutex;
+    std::map<std::string, unsigned long> m_jobTypeChannels;
+    std::map<std::string, JobRetryPolicy> m_jobTypeRetryPolicies;
+    std::map<std::string, std::unique_ptr<JobTypeMetrics>> m_jobTypeMetrics;
+    mutable JobMutex m_jobFactoriesMutex{"JobSystem::m_jobFactoriesMutex"};
 
-    // Mapping job namse to their unique IDs
-    std::unordered_map<std::string, int> m_jobNameToID;
-    mutable std::mutex m_jobNameToIDMutex;
-    std::unordered_map<int, Job *> m_jobs;
-    mutable std::mutex m_jobsMutex;
+    // Job names to their unique IDs, per graph run. Every named job adds a node, so they come from the job pool
+    using JobRunNames = std::unordered_map<std::string, JobID, std::hash<std::string>, std::equal_to<std::string>,
+                                           JobPoolAllocator<std::pair<const std::string, JobID>>>;
+    std::unordered_map<JobRunID, JobRunNames, std::hash<JobRunID>, std::equal_to<JobRunID>,
+                       JobPoolAllocator<std::pair<const JobRunID, JobRunNames>>>
+        m_graphRuns;
+    std::atomic<JobRunID> m_nextRunID{DEFAULT_JOB_RUN_ID + 1};
+    mutable JobMutex m_graphRunsMutex{"JobSystem::m_graphRunsMutex"};
+    std::unordered_map<JobID, Job *, std::hash<JobID>, std::equal_to<JobID>, JobPoolAllocator<std::pair<const JobID, Job *>>> m_jobs;
+    mutable JobMutex m_jobsMutex{"JobSystem::m_jobsMutex"};
 
     std::vector<JobWorkerThread *> m_workerThreads;
-    mutable std::mutex m_workerThreadMutex;
-    std::deque<Job *> m_jobsQueued;
-    std::deque<Job *> m_jobsRunning;
-    std::deque<Job *> m_jobsCompleted;
-    mutable std::mutex m_jobsQueuedMutex;
-    mutable std::mutex m_jobsRunningMutex;
-    mutable std::mutex m_jobsCompletedMutex;
-
-    std::vector<JobHistoryEntry> m_jobHistory;
-    mutable int m_jobHistoryLowestActiveIndex = 0;
-    mutable std::mutex m_jobHistoryMutex;
+    // Elastic workers that have left the pool, joined the next time the pool changes
+    std::vector<JobWorkerThread *> m_retiredWorkers;
+    bool m_isShuttingDown = false;
+    mutable JobMutex m_workerThreadMutex{"JobSystem::m_workerThreadMutex"};
+
+    // Pools are filled in before the count is raised and never removed, so the job paths read them without a lock
+    JobElasticPool m_elasticPools[MAX_JOB_ELASTIC_POOLS];
+    std::atomic<int> m_numElasticPools{0};
+
+    // Snapshot of every worker's local queue, replaced whenever a worker is created or destroyed.
+    // Thieves copy the pointer and never hold m_workerThreadMutex, which is held while joining workers
+    std::shared_ptr<const std::vector<std::shared_ptr<JobWorkerQueue>>> m_workerQueues;
+    mutable JobMutex m_workerQueuesMutex{"JobSystem::m_workerQueuesMutex"};
+
+    // Global ready queues for jobs queued from outside the workers, or that a worker cannot run itself.
+    // The last queue is shared by every mask past the limit and is the only one that needs a scan
+    JobChannelQueue m_channelQueues[MAX_JOB_CHANNEL_QUEUES];
+    int m_numChannelQueues = 0;
+    unsigned long long m_nonEmptyChannelQueues = 0;
+    unsigned long long m_channelQueuesGeneration = 0;
+    unsigned long long m_nextReadySequence = 0;
+    // High priority or deadline jobs waiting in the ready queues, workers check the global queues
+    // before their local one while this is non-zero. Low priority jobs are not counted
+    std::atomic<int> m_numPrioritizedReadyJobs{0};
+    // Lowest schedule key in the ready queues, LLONG_MAX while they are empty. Once it is more than
+    // an aging step old, workers check the global queues before their local one as well, so jobs
+    // waiting there still run while workers keep releasing local successors
+    std::atomic<long long> m_oldestReadyScheduleKey{LLONG_MAX};
+    mutable JobMutex m_jobsQueuedMutex{"JobSystem::m_jobsQueuedMutex"};
+    JobList m_jobsRunning;
+    JobList m_jobsCompleted;
+    mutable JobMutex m_jobsRunningMutex{"JobSystem::m_jobsRunningMutex"};
+    mutable JobMutex m_jobsCompletedMutex{"JobSystem::m_jobsCompletedMutex"};
+
+    // Bumped every time a job is released, so a worker about to go idle knows something changed
+    unsigned long long m_jobsAvailableGeneration = 0;
+    // Workers waiting for jobs, each on its own condition, the most recently idle last
+    std::vector<JobWorkerThread *> m_idleWorkers;
+    mutable JobMutex m_jobsAvailableMutex{"JobSystem::m_jobsAvailableMutex"};
+
+    // Status of every job by ID, lock-free to read
+    JobStatusTable m_jobHistory;
+
+    std::unique_ptr<JobReactor> m_reactor;
+    // Handed out without the lock once started, reactor callbacks that cancel jobs come back for it
+    std::atomic<JobReactor *> m_reactorInstance{nullptr};
+    JobMutex m_reactorMutex{"JobSystem::m_reactorMutex"};
+
+    // Completed jobs waiting for their callback on the callback thread
+    std::atomic<int> m_callbackMode{JOB_CALLBACK_ON_FINISH};
+    std::thread m_callbackThread;
+    std::vector<Job *> m_pendingCallbacks;
+    bool m_isStoppingCallbacks = false;
+    JobConditionVariable m_pendingCallbacksCondition;
+    JobMutex m_callbacksMutex{"JobSystem::m_callbacksMutex"};
+
+    // Workers get their index from here, so trace threads stay apart as elastic workers come and go
+    std::atomic<int> m_numWorkersCreated{0};
+    JobTracer m_tracer;
+
+    JobTypeMetrics *m_postedJobMetrics = nullptr;
+    std::chrono::steady_clock::time_point m_metricsStartTime;
+    // Where the last snapshot left off, for its throughput
+    std::chrono::steady_clock::time_point m_lastMetricsTime;
+    unsigned long long m_lastMetricsCompleted = 0;
+    JobMutex m_metricsMutex{"JobSystem::m_metricsMutex"};
 
     std::vector<std::string> m_availableJobTypes;
-    mutable std::mutex m_availableJobTypeMutex;
+    mutable JobMutex m_availableJobTypeMutex{"JobSystem::m_availableJobTypeMutex"};
 };
\ No newline at end of file
@@ -1,13 +1,31 @@
 #include "jobsystemapi.h"
+#include <algorithm>
 
-JobSystemAPI::JobSystemAPI()
+JobSystemAPI::JobSystemAPI(JobPlacementPolicy placementPolicy) : m_placementPolicy(placementPolicy)
 {
-    m_jobSystem = JobSystem::CreateOrGet();
+    CreateJobSystem();
+}
+
+void JobSystemAPI::CreateJobSystem()
+{
+    m_jobSystem = new JobSystem();
+    isDestroyed = false;
+
+    // CPU pool, one worker per core for parsing and output work, spread over the NUMA nodes by the placement policy
+    int numCores = std::max(1, JobTopology::GetNumCores());
+    for (int n = 0; n < numCores; ++n)
+    {
+        std::string threadName = "CPU Thread " + std::to_string(n);
+        m_jobSystem->CreateWorkerThread(threadName.c_str(), JOB_CHANNEL_CPU, JobTopology::GetSpreadPlacement(m_placementPolicy, n));
+    }
+
+    // I/O pool, grows with the number of subprocess jobs in flight so they never hold up the CPU pool
+    m_jobSystem->CreateElasticWorkerPool("IO Thread", JOB_CHANNEL_IO, IO_POOL_MIN_WORKERS, IO_POOL_MAX_WORKERS, IO_POOL_IDLE_TIMEOUT);
 
-    for (unsigned int n = 1; n < std::thread::hardware_concurrency(); ++n)
+    m_jobSystem->SetCallbackMode(m_callbackMode);
+    if (m_traceMaxJobs > 0)
     {
-        std::string threadName = "Thread " + std::to_string(n);
-        m_jobSystem->CreateWorkerThread(threadName.c_str(), 0xFFFFFFFF);
+        m_jobSystem->StartTrace(m_traceMaxJobs);
     }
 }
 
@@ -20,7 +38,7 @@ void JobSystemAPI::Start()
 {
     if (m_jobSystem == nullptr)
     {
-        m_jobSystem = JobSystem::CreateOrGet();
+        CreateJobSystem();
     }
 }
 
@@ -38,7 +56,7 @@ void JobSystemAPI::Destroy()
     if (isDestroyed)
         return; // Prevent double destruction
     m_jobSystem->FinishCompletedJobs();
-    m_jobSystem->Destroy();
+    delete m_jobSystem;
     m_jobSystem = nullptr;
     isDestroyed = true;
 }
@@ -48,9 +66,39 @@ nlohmann::json JobSystemAPI::CreateJob(const char *jobName, nlohmann::json &inpu
     return m_jobSystem->CreateJob(std::string(jobName), input);
 }
 
+JobRunID JobSystemAPI::CreateGraphRun()
+{
+    return m_jobSystem->CreateGraphRun();
+}
+
+void JobSystemAPI::CloseGraphRun(JobRunID runId)
+{
+    m_jobSystem->CloseGraphRun(runId);
+}
+
+nlohmann::json JobSystemAPI::CreateJob(const char *jobType, nlohmann::json &input, JobRunID runId, const char *jobName)
+{
+    return m_jobSystem->CreateJob(std::string(jobType), input, runId, std::string(jobName));
+}
+
+nlohmann::json JobSystemAPI::GetMetrics()
+{
+    return m_jobSystem->GetMetrics();
+}
+
+nlohmann::json JobSystemAPI::GetLockReport()
+{
+    return JobLockProfiler::GetReport();
+}
+
+nlohmann::json JobSystemAPI::SubmitGraph(const nlohmann::json &graphSpec)
+{
+    return m_jobSystem->SubmitGraph(graphSpec);
+}
+
 nlohmann::json JobSystemAPI::JobStatus(std::string &jobID)
 {
-    int jobInt = stoi(jobID);
+    JobID jobInt = stoll(jobID);
     int status = m_jobSystem->GetJobStatus(jobInt);
 
     nlohmann::json jsonResponse;
@@ -73,6 +121,9 @@ nlohmann::json JobSystemAPI::JobStatus(std::string &jobID)
     case JOB_STATUS_RETIRED:
         jsonResponse["status"] = "retired";
         break;
+    case JOB_STATUS_CANCELLED:
+        jsonResponse["status"] = "cancelled";
+        break;
     default:
         jsonResponse["status"] = "unknown";
         break;
@@ -81,19 +132,18 @@ nlohmann::json JobSystemAPI::JobStatus(std::string &jobID)
     return jsonResponse;
 }
 
-nlohmann::json JobSystemAPI::FinishJob(std::string &jobID)
+nlohmann::json JobSystemAPI::FinishJob(const JobHandle &jobHandle)
 {
-    int jobInt = stoi(jobID);
-    return m_jobSystem->FinishJob(jobInt);
+    return m_jobSystem->FinishJob(jobHandle);
 }
 
-void JobSystemAPI::StoreJobOutput(int jobID, const nlohmann::json &output)
+void JobSystemAPI::StoreJobOutput(JobID jobID, const nlohmann::json &output)
 {
     std::lock_guard<std::mutex> lock(m_jobOutputsMutex);
     m_jobOutputs[jobID] = output;
 }
 
-nlohmann::json JobSystemAPI::GetJobOutput(int jobID)
+nlohmann::json JobSystemAPI::GetJobOutput(JobID jobID)
 {
     std::lock_guard<std::mutex> lock(m_jobOutputsMutex);
     auto it = m_jobOutputs.find(jobID);
@@ -113,17 +163,99 @@ nlohmann::json JobSystemAPI::GetJobTypes()
     return jsonResponse;
 }
 
-void JobSystemAPI::QueueJob(int jobId)
+JobHandle JobSystemAPI::QueueJob(JobID jobId)
 {
-    m_jobSystem->QueueJob(jobId);
+    return m_jobSystem->QueueJob(jobId);
 }
 
-void JobSystemAPI::RegisterJob(const char *jobName, std::function<Job *()> jobFactory)
+JobHandle JobSystemAPI::QueueJobAfter(JobID jobId, JobID previousJobId)
 {
-    m_jobSystem->RegisterJobType(std::string(jobName), jobFactory);
+    return m_jobSystem->QueueJobAfter(jobId, previousJobId);
+}
+
+nlohmann::json JobSystemAPI::CancelJob(JobID jobId)
+{
+    nlohmann::json jsonResponse;
+    jsonResponse["jobID"] = jobId;
+    if (!m_jobSystem->CancelJob(jobId))
+    {
+        jsonResponse["error"] = "Job not found, already complete or already cancelled";
+        return jsonResponse;
+    }
+    jsonResponse["status"] = "cancelled";
+    return jsonResponse;
+}
+
+JobCancelToken JobSystemAPI::GetCancelToken(JobID jobId)
+{
+    return m_jobSystem->GetCancelToken(jobId);
+}
+
+JobHandle JobSystemAPI::GetJobHandle(JobID jobId) const
+{
+    return m_jobSystem->GetJobHandle(jobId);
+}
+
+void JobSystemAPI::RegisterJob(const char *jobName, std::function<Job *()> jobFactory, unsigned long jobChannels)
+{
+    m_jobSystem->RegisterJobType(std::string(jobName), jobFactory, jobChannels);
+}
+
+void JobSystemAPI::SetRetryPolicy(const char *jobName, const JobRetryPolicy &retryPolicy)
+{
+    m_jobSystem->SetRetryPolicy(std::string(jobName), retryPolicy);
 }
 
 void JobSystemAPI::SetDependency(const char *dependentJobName, const char *dependencyJobName)
 {
     m_jobSystem->SetDependency(std::string(dependentJobName), std::string(dependencyJobName));
 }
+
+void JobSystemAPI::SetDependency(JobRunID runId, const char *dependentJobName, const char *dependencyJobName)
+{
+    m_jobSystem->SetDependency(runId, std::string(dependentJobName), std::string(dependencyJobName));
+}
+
+void JobSystemAPI::SetCallbackMode(JobCallbackMode callbackMode)
+{
+    m_callbackMode = callbackMode;
+    if (m_jobSystem != nullptr)
+    {
+        m_jobSystem->SetCallbackMode(callbackMode);
+    }
+}
+
+void JobSystemAPI::StartTrace(size_t maxJobs)
+{
+    m_traceMaxJobs = maxJobs;
+    if (m_jobSystem != nullptr)
+    {
+        m_jobSystem->StartTrace(maxJobs);
+    }
+}
+
+void JobSystemAPI::StopTrace()
+{
+    m_traceMaxJobs = 0;
+    if (m_jobSystem != nullptr)
+    {
+        m_jobSystem->StopTrace();
+    }
+}
+
+bool JobSystemAPI::WriteTrace(const std::string &tracePath)
+{
+    if (m_jobSystem == nullptr)
+    {
+        return false;
+    }
+
+    std::ofstream traceFile(tracePath);
+    if (!traceFile.is_open())
+    {
+        std::cerr << "Could not open trace file: " << tracePath << std::endl;
+        return false;
+    }
+    traceFile << m_jobSystem->ExportTrace().dump();
+    return traceFile.good();
+}
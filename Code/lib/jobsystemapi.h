@@ -10,10 +10,15 @@
 
 class JobSystem;
 
+// Elastic I/O pool limits, blocked subprocess jobs each hold an I/O worker while the CPU pool keeps running
+constexpr int IO_POOL_MIN_WORKERS = 1;
+constexpr int IO_POOL_MAX_WORKERS = 32;
+constexpr std::chrono::milliseconds IO_POOL_IDLE_TIMEOUT(5000);
+
 class JobSystemAPI
 {
 public:
-    JobSystemAPI();
+    JobSystemAPI(JobPlacementPolicy placementPolicy = JOB_PLACEMENT_NUMA_NODES);
     ~JobSystemAPI();
 
     void Destroy();
@@ -21,23 +26,57 @@ public:
     void Stop();
 
     nlohmann::json JobStatus(std::string &);
-    nlohmann::json FinishJob(std::string &);
+    nlohmann::json FinishJob(const JobHandle &jobHandle);
     nlohmann::json CreateJob(const char *, nlohmann::json &);
+    // Graph runs keep each instance's job names apart, see JobSystem::CreateGraphRun()
+    JobRunID CreateGraphRun();
+    void CloseGraphRun(JobRunID runId);
+    nlohmann::json CreateJob(const char *jobType, nlohmann::json &input, JobRunID runId, const char *jobName = "");
+    nlohmann::json SubmitGraph(const nlohmann::json &graphSpec);
     nlohmann::json GetJobTypes();
+    // Queue depths, worker utilization, throughput and latency histograms per job type, see JobSystem::GetMetrics()
+    nlohmann::json GetMetrics();
+    // Wait and hold times of the job system's locks, see JobLockProfiler
+    nlohmann::json GetLockReport();
+
+    void StoreJobOutput(JobID jobID, const nlohmann::json &output);
+    nlohmann::json GetJobOutput(JobID jobID);
 
-    void StoreJobOutput(int jobID, const nlohmann::json &output);
-    nlohmann::json GetJobOutput(int jobID);
+    JobHandle QueueJob(JobID jobId);
+    JobHandle QueueJobAfter(JobID jobId, JobID previousJobId);
 
-    void QueueJob(int jobId);
+    // Jobs also take a "timeoutMs" input, after which the scheduler cancels them the same way
+    nlohmann::json CancelJob(JobID jobId);
+    JobCancelToken GetCancelToken(JobID jobId);
+    JobHandle GetJobHandle(JobID jobId) const;
 
-    void RegisterJob(const char *, std::function<Job *()>);
+    // Non-zero channels route every job of the type, e.g. JOB_CHANNEL_IO for jobs that block
+    void RegisterJob(const char *, std::function<Job *()>, unsigned long jobChannels = 0);
+    void SetRetryPolicy(const char *jobName, const JobRetryPolicy &retryPolicy);
 
     void SetDependency(const char *dependentJobName, const char *dependencyJobName);
+    void SetDependency(JobRunID runId, const char *dependentJobName, const char *dependencyJobName);
+
+    // Kept across Destroy() and Start(), every job system this API creates uses it
+    void SetCallbackMode(JobCallbackMode callbackMode);
+
+    // Job timelines for chrome://tracing or ui.perfetto.dev. Tracing carries over to the job system
+    // Start() creates, but the trace itself goes with the job system, write it before Destroy()
+    void StartTrace(size_t maxJobs = 100000);
+    void StopTrace();
+    bool WriteTrace(const std::string &tracePath);
 
 private:
-    JobSystem *m_jobSystem;
+    void CreateJobSystem();
+
+    // Owned by this API, every JobSystemAPI runs its own job system and worker pool
+    JobSystem *m_jobSystem = nullptr;
+    JobPlacementPolicy m_placementPolicy = JOB_PLACEMENT_NUMA_NODES;
+    JobCallbackMode m_callbackMode = JOB_CALLBACK_ON_FINISH;
+    // Zero while not tracing
+    size_t m_traceMaxJobs = 0;
     bool isDestroyed = false;
 
-    std::map<int, nlohmann::json> m_jobOutputs;
+    std::map<JobID, nlohmann::json> m_jobOutputs;
     std::mutex m_jobOutputsMutex;
 };
\ No newline at end of file
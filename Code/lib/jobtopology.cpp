@@ -0,0 +1,233 @@
+#include "jobtopology.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <cctype>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#endif
+
+JobWorkerPlacement JobWorkerPlacement::Core(int core)
+{
+    JobWorkerPlacement placement;
+    placement.m_cores.push_back(core);
+    return placement;
+}
+
+JobWorkerPlacement JobWorkerPlacement::CoreSet(const std::vector<int> &cores)
+{
+    JobWorkerPlacement placement;
+    placement.m_cores = cores;
+    return placement;
+}
+
+JobWorkerPlacement JobWorkerPlacement::NumaNode(int numaNode)
+{
+    JobWorkerPlacement placement;
+    placement.m_numaNode = numaNode;
+    return placement;
+}
+
+const std::vector<JobNumaNode> &JobTopology::GetNumaNodes()
+{
+    static const std::vector<JobNumaNode> s_numaNodes = ReadNumaNodes();
+    return s_numaNodes;
+}
+
+int JobTopology::GetNumCores()
+{
+    int numCores = 0;
+    for (const JobNumaNode &numaNode : GetNumaNodes())
+    {
+        numCores += (int)numaNode.m_cores.size();
+    }
+    return numCores;
+}
+
+std::vector<JobNumaNode> JobTopology::ReadNumaNodes()
+{
+    std::vector<JobNumaNode> numaNodes;
+    std::vector<int> allowedCores;
+
+#ifdef __linux__
+    // Only cores the process may run on count, containers and taskset can hide some of them
+    cpu_set_t allowedSet;
+    CPU_ZERO(&allowedSet);
+    if (sched_getaffinity(0, sizeof(allowedSet), &allowedSet) == 0)
+    {
+        for (int core = 0; core < CPU_SETSIZE; ++core)
+        {
+            if (CPU_ISSET(core, &allowedSet))
+            {
+                allowedCores.push_back(core);
+            }
+        }
+    }
+
+    DIR *nodeDirectory = opendir("/sys/devices/system/node");
+    if (nodeDirectory != nullptr)
+    {
+        while (dirent *entry = readdir(nodeDirectory))
+        {
+            std::string entryName = entry->d_name;
+            if ((entryName.compare(0, 4, "node") != 0) || (entryName.size() == 4) ||
+                !std::all_of(entryName.begin() + 4, entryName.end(), ::isdigit))
+            {
+                continue;
+            }
+
+            std::ifstream cpuListFile("/sys/devices/system/node/" + entryName + "/cpulist");
+            std::string cpuList;
+            if (!std::getline(cpuListFile, cpuList))
+            {
+                continue;
+            }
+
+            JobNumaNode numaNode;
+            numaNode.m_nodeID = std::stoi(entryName.substr(4));
+            for (int core : ParseCpuList(cpuList))
+            {
+                if (allowedCores.empty() || std::binary_search(allowedCores.begin(), allowedCores.end(), core))
+                {
+                    numaNode.m_cores.push_back(core);
+                }
+            }
+
+            // Memory-only nodes, or nodes we are not allowed on, have nothing to place workers on
+            if (!numaNode.m_cores.empty())
+            {
+                numaNodes.push_back(numaNode);
+            }
+        }
+        closedir(nodeDirectory);
+    }
+#endif
+
+    std::sort(numaNodes.begin(), numaNodes.end(), [](const JobNumaNode &lhs, const JobNumaNode &rhs)
+              { return lhs.m_nodeID < rhs.m_nodeID; });
+
+    // No NUMA information, one node with every core
+    if (numaNodes.empty())
+    {
+        JobNumaNode numaNode;
+        numaNode.m_cores = allowedCores;
+        if (numaNode.m_cores.empty())
+        {
+            int numCores = std::max(1, (int)std::thread::hardware_concurrency());
+            for (int core = 0; core < numCores; ++core)
+            {
+                numaNode.m_cores.push_back(core);
+            }
+        }
+        numaNodes.push_back(numaNode);
+    }
+
+    return numaNodes;
+}
+
+JobWorkerPlacement JobTopology::GetSpreadPlacement(JobPlacementPolicy placementPolicy, int workerIndex)
+{
+    const std::vector<JobNumaNode> &numaNodes = GetNumaNodes();
+
+    if (placementPolicy == JOB_PLACEMENT_NUMA_NODES)
+    {
+        // Binding to the only node would not restrict anything
+        if (numaNodes.size() < 2)
+        {
+            return JobWorkerPlacement();
+        }
+        return JobWorkerPlacement::NumaNode(numaNodes[workerIndex % numaNodes.size()].m_nodeID);
+    }
+
+    if (placementPolicy == JOB_PLACEMENT_CORES)
+    {
+        // Take the first core of every node, then the second and so on, so neighbouring workers land on different nodes
+        std::vector<int> spreadCores;
+        for (size_t round = 0; spreadCores.size() < (size_t)GetNumCores(); ++round)
+        {
+            for (const JobNumaNode &numaNode : numaNodes)
+            {
+                if (round < numaNode.m_cores.size())
+                {
+                    spreadCores.push_back(numaNode.m_cores[round]);
+                }
+            }
+        }
+        return JobWorkerPlacement::Core(spreadCores[workerIndex % spreadCores.size()]);
+    }
+
+    return JobWorkerPlacement();
+}
+
+std::vector<int> JobTopology::ResolveCores(const JobWorkerPlacement &placement)
+{
+    if (!placement.m_cores.empty())
+    {
+        return placement.m_cores;
+    }
+
+    if (placement.m_numaNode >= 0)
+    {
+        for (const JobNumaNode &numaNode : GetNumaNodes())
+        {
+            if (numaNode.m_nodeID == placement.m_numaNode)
+            {
+                return numaNode.m_cores;
+            }
+        }
+        std::cerr << "JobTopology: no NUMA node " << placement.m_numaNode << " on this machine" << std::endl;
+    }
+
+    return std::vector<int>();
+}
+
+bool JobTopology::PinCurrentThread(const std::vector<int> &cores)
+{
+#ifdef __linux__
+    cpu_set_t coreSet;
+    CPU_ZERO(&coreSet);
+    for (int core : cores)
+    {
+        if ((core >= 0) && (core < CPU_SETSIZE))
+        {
+            CPU_SET(core, &coreSet);
+        }
+    }
+
+    if (CPU_COUNT(&coreSet) == 0)
+    {
+        return false;
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(coreSet), &coreSet) == 0;
+#else
+    return false;
+#endif
+}
+
+std::vector<int> JobTopology::ParseCpuList(const std::string &cpuList)
+{
+    std::vector<int> cores;
+    std::stringstream cpuListStream(cpuList);
+    std::string range;
+    while (std::getline(cpuListStream, range, ','))
+    {
+        if (range.empty() || !::isdigit((unsigned char)range[0]))
+        {
+            continue;
+        }
+
+        size_t dashPos = range.find('-');
+        int firstCore = std::stoi(range.substr(0, dashPos));
+        int lastCore = (dashPos == std::string::npos) ? firstCore : std::stoi(range.substr(dashPos + 1));
+        for (int core = firstCore; core <= lastCore; ++core)
+        {
+            cores.push_back(core);
+        }
+    }
+    return cores;
+}
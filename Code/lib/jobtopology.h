@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <string>
+
+// One NUMA node and the logical cores of it this process may run on
+struct JobNumaNode
+{
+    int m_nodeID = 0;
+    std::vector<int> m_cores;
+};
+
+// Where a worker thread may run, a core set wins over a NUMA node. Leaving both unset lets the OS place it
+struct JobWorkerPlacement
+{
+    std::vector<int> m_cores;
+    int m_numaNode = -1;
+
+    static JobWorkerPlacement Core(int core);
+    static JobWorkerPlacement CoreSet(const std::vector<int> &cores);
+    static JobWorkerPlacement NumaNode(int numaNode);
+
+    bool IsPinned() const { return !m_cores.empty() || (m_numaNode >= 0); }
+};
+
+// How JobSystemAPI places its CPU workers
+enum JobPlacementPolicy
+{
+    JOB_PLACEMENT_NONE,       // Leave placement to the OS
+    JOB_PLACEMENT_NUMA_NODES, // Bind each worker to one NUMA node, taking the nodes in turn
+    JOB_PLACEMENT_CORES,      // Pin each worker to its own core, taking the nodes in turn
+};
+
+// Machine layout as seen by the job system, read once from /sys/devices/system/node on Linux.
+// Other platforms, and machines without NUMA, report a single node holding every core
+class JobTopology
+{
+public:
+    static const std::vector<JobNumaNode> &GetNumaNodes();
+    static int GetNumCores();
+
+    // Placement for the workerIndex'th worker under the policy, spread across the nodes
+    static JobWorkerPlacement GetSpreadPlacement(JobPlacementPolicy placementPolicy, int workerIndex);
+
+    // The cores a placement allows, empty when it leaves placement to the OS
+    static std::vector<int> ResolveCores(const JobWorkerPlacement &placement);
+
+    // Restricts the calling thread to the cores, false if the platform or the OS refused
+    static bool PinCurrentThread(const std::vector<int> &cores);
+
+    // Parses the kernel's cpu list format, e.g. "0-3,8-11"
+    static std::vector<int> ParseCpuList(const std::string &cpuList);
+
+private:
+    static std::vector<JobNumaNode> ReadNumaNodes();
+};
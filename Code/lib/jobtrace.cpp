@@ -0,0 +1,170 @@
+#include "jobtrace.h"
+
+// Every event goes under one process, workers are its threads and tid 0 holds the async slices
+static constexpr int TRACE_PROCESS_ID = 1;
+
+static double ToTraceMicroseconds(JobTimeline::TimePoint timePoint)
+{
+    return std::chrono::duration<double, std::micro>(timePoint.time_since_epoch()).count();
+}
+
+static double GetElapsedMicroseconds(JobTimeline::TimePoint startTime, JobTimeline::TimePoint endTime)
+{
+    if (!JobTimeline::IsSet(startTime) || !JobTimeline::IsSet(endTime))
+    {
+        return 0.0;
+    }
+    return std::chrono::duration<double, std::micro>(endTime - startTime).count();
+}
+
+// Async slices with the same id nest, which puts every stage of a job under one track. Stages that
+// took no time, like waiting on dependencies for a job without any, are left out
+static void AddAsyncSlice(nlohmann::json &traceEvents, const std::string &name, const std::string &asyncID,
+                          JobTimeline::TimePoint startTime, JobTimeline::TimePoint endTime)
+{
+    if (!JobTimeline::IsSet(startTime) || !JobTimeline::IsSet(endTime) || (endTime <= startTime))
+    {
+        return;
+    }
+
+    nlohmann::json beginEvent;
+    beginEvent["name"] = name;
+    beginEvent["cat"] = "job";
+    beginEvent["ph"] = "b";
+    beginEvent["id"] = asyncID;
+    beginEvent["ts"] = ToTraceMicroseconds(startTime);
+    beginEvent["pid"] = TRACE_PROCESS_ID;
+    beginEvent["tid"] = 0;
+
+    nlohmann::json endEvent = beginEvent;
+    endEvent["ph"] = "e";
+    endEvent["ts"] = ToTraceMicroseconds(endTime);
+
+    traceEvents.push_back(std::move(beginEvent));
+    traceEvents.push_back(std::move(endEvent));
+}
+
+static void AddTimelineStage(nlohmann::json &timeline, const char *stageName, JobTimeline::TimePoint timePoint)
+{
+    if (JobTimeline::IsSet(timePoint))
+    {
+        timeline[stageName] = std::chrono::duration<double, std::milli>(timePoint.time_since_epoch()).count();
+    }
+}
+
+nlohmann::json JobTimeline::ToJson() const
+{
+    nlohmann::json timeline = nlohmann::json::object();
+    AddTimelineStage(timeline, "createdMs", m_createdTime);
+    AddTimelineStage(timeline, "queuedMs", m_queuedTime);
+    AddTimelineStage(timeline, "releasedMs", m_releasedTime);
+    AddTimelineStage(timeline, "claimedMs", m_claimedTime);
+    AddTimelineStage(timeline, "executeStartMs", m_executeStartTime);
+    AddTimelineStage(timeline, "executeEndMs", m_executeEndTime);
+    AddTimelineStage(timeline, "completedMs", m_completedTime);
+    AddTimelineStage(timeline, "callbackStartMs", m_callbackStartTime);
+    AddTimelineStage(timeline, "callbackEndMs", m_callbackEndTime);
+    AddTimelineStage(timeline, "retiredMs", m_retiredTime);
+    timeline["workerIndex"] = m_workerIndex;
+    return timeline;
+}
+
+void JobTracer::Start(size_t maxRecords)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxRecords = maxRecords;
+    m_isTracing.store(true);
+}
+
+void JobTracer::Stop()
+{
+    m_isTracing.store(false);
+}
+
+void JobTracer::Record(JobTraceRecord &&record)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_records.push_back(std::move(record));
+    while (m_records.size() > m_maxRecords)
+    {
+        m_records.pop_front();
+        ++m_numDropped;
+    }
+}
+
+void JobTracer::SetWorkerName(int workerIndex, const std::string &workerName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_workerNames[workerIndex] = workerName;
+}
+
+nlohmann::json JobTracer::ExportChromeTrace() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    nlohmann::json traceEvents = nlohmann::json::array();
+
+    // Names for the process and its threads, worker tids are their index plus one
+    nlohmann::json processName;
+    processName["name"] = "process_name";
+    processName["ph"] = "M";
+    processName["pid"] = TRACE_PROCESS_ID;
+    processName["args"]["name"] = "JobSystem";
+    traceEvents.push_back(std::move(processName));
+
+    for (const auto &workerName : m_workerNames)
+    {
+        nlohmann::json threadName;
+        threadName["name"] = "thread_name";
+        threadName["ph"] = "M";
+        threadName["pid"] = TRACE_PROCESS_ID;
+        threadName["tid"] = workerName.first + 1;
+        threadName["args"]["name"] = workerName.second;
+        traceEvents.push_back(std::move(threadName));
+    }
+
+    for (const JobTraceRecord &record : m_records)
+    {
+        const JobTimeline &timeline = record.m_timeline;
+        std::string asyncID = std::to_string(record.m_jobID) + "." + std::to_string(record.m_attempt);
+        std::string jobLabel = record.m_jobType + " #" + std::to_string(record.m_jobID);
+
+        // Outermost first, the stages nest inside the job's whole life
+        JobTimeline::TimePoint endOfLife = JobTimeline::IsSet(timeline.m_retiredTime) ? timeline.m_retiredTime : timeline.m_completedTime;
+        AddAsyncSlice(traceEvents, jobLabel, asyncID, timeline.m_createdTime, endOfLife);
+        AddAsyncSlice(traceEvents, "waiting on dependencies", asyncID, timeline.m_queuedTime, timeline.m_releasedTime);
+        AddAsyncSlice(traceEvents, "waiting for a worker", asyncID, timeline.m_releasedTime, timeline.m_claimedTime);
+        AddAsyncSlice(traceEvents, "running", asyncID, timeline.m_claimedTime, timeline.m_completedTime);
+        AddAsyncSlice(traceEvents, "callback", asyncID, timeline.m_callbackStartTime, timeline.m_callbackEndTime);
+
+        if (!JobTimeline::IsSet(timeline.m_executeStartTime))
+        {
+            continue;
+        }
+
+        nlohmann::json executeEvent;
+        executeEvent["name"] = record.m_jobType;
+        executeEvent["cat"] = "execute";
+        executeEvent["ph"] = "X";
+        executeEvent["ts"] = ToTraceMicroseconds(timeline.m_executeStartTime);
+        executeEvent["dur"] = GetElapsedMicroseconds(timeline.m_executeStartTime, timeline.m_executeEndTime);
+        executeEvent["pid"] = TRACE_PROCESS_ID;
+        executeEvent["tid"] = timeline.m_workerIndex + 1;
+
+        nlohmann::json &args = executeEvent["args"];
+        args["jobId"] = record.m_jobID;
+        args["name"] = record.m_jobName;
+        args["runId"] = record.m_runID;
+        args["attempt"] = record.m_attempt;
+        args["result"] = record.m_result;
+        args["queueWaitUs"] = GetElapsedMicroseconds(timeline.m_releasedTime, timeline.m_claimedTime);
+        args["executeUs"] = GetElapsedMicroseconds(timeline.m_executeStartTime, timeline.m_executeEndTime);
+        args["runningUs"] = GetElapsedMicroseconds(timeline.m_claimedTime, timeline.m_completedTime);
+        traceEvents.push_back(std::move(executeEvent));
+    }
+
+    nlohmann::json trace;
+    trace["traceEvents"] = std::move(traceEvents);
+    trace["displayTimeUnit"] = "ms";
+    trace["otherData"]["droppedJobs"] = m_numDropped;
+    return trace;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <mutex>
+#include <map>
+#include <deque>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <nlohmann/json.hpp>
+#include "jobid.h"
+
+// When a job reached each stage of its life. Stages it never reached stay at the clock's epoch,
+// a job cancelled before it ran has no execute times and one nobody waited on has no callback
+struct JobTimeline
+{
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    TimePoint m_createdTime;
+    TimePoint m_queuedTime;       // QueueJob(), or its last dependency completing
+    TimePoint m_releasedTime;     // Pushed onto a ready queue, every dependency has completed
+    TimePoint m_claimedTime;      // Taken off a ready queue by a worker
+    TimePoint m_executeStartTime;
+    TimePoint m_executeEndTime;   // Execute() returned, a deferred job completes later
+    TimePoint m_completedTime;
+    TimePoint m_callbackStartTime;
+    TimePoint m_callbackEndTime;
+    TimePoint m_retiredTime;
+    // Job system index of the worker that claimed the job, -1 until one does
+    int m_workerIndex = -1;
+
+    static TimePoint Now() { return std::chrono::steady_clock::now(); }
+    static bool IsSet(TimePoint timePoint) { return timePoint != TimePoint(); }
+
+    // Milliseconds on the steady clock for every stage the job reached, comparable with
+    // std::chrono::steady_clock::now() taken anywhere in the same process
+    nlohmann::json ToJson() const;
+};
+
+// A retired job's timeline, or that of a failed attempt that was retried
+struct JobTraceRecord
+{
+    JobID m_jobID = INVALID_JOB_ID;
+    JobRunID m_runID = DEFAULT_JOB_RUN_ID;
+    std::string m_jobType;
+    std::string m_jobName;
+    int m_attempt = 1;
+    // "completed", "cancelled" or "retried"
+    std::string m_result;
+    JobTimeline m_timeline;
+};
+
+// Keeps job timelines while tracing is on and exports them as Chrome trace event JSON, which
+// chrome://tracing and ui.perfetto.dev open as is. Execution shows as a slice on the worker that ran
+// the job, the time spent waiting on dependencies, for a worker, and for the callback as async slices
+// per job. With tracing off, jobs only pay for taking their timestamps
+class JobTracer
+{
+public:
+    // Starting again keeps what was already recorded, the limit only ever drops the oldest records
+    void Start(size_t maxRecords);
+    void Stop();
+    bool IsTracing() const { return m_isTracing.load(std::memory_order_relaxed); }
+
+    void Record(JobTraceRecord &&record);
+    void SetWorkerName(int workerIndex, const std::string &workerName);
+
+    nlohmann::json ExportChromeTrace() const;
+
+private:
+    std::atomic<bool> m_isTracing{false};
+    size_t m_maxRecords = 0;
+    size_t m_numDropped = 0;
+    std::deque<JobTraceRecord> m_records;
+    std::map<int, std::string> m_workerNames;
+    mutable std::mutex m_mutex;
+};
@@ -0,0 +1,59 @@
+#include "jobworkerqueue.h"
+#include "job.h"
+
+void JobWorkerQueue::PushJob(Job *job)
+{
+    std::lock_guard<JobMutex> lock(m_jobsMutex);
+    m_jobs.push_back(job);
+}
+
+Job *JobWorkerQueue::PopJob()
+{
+    std::lock_guard<JobMutex> lock(m_jobsMutex);
+    if (m_jobs.empty())
+    {
+        return nullptr;
+    }
+
+    Job *job = m_jobs.back();
+    m_jobs.pop_back();
+    return job;
+}
+
+Job *JobWorkerQueue::StealJob(unsigned long thiefJobChannels)
+{
+    std::lock_guard<JobMutex> lock(m_jobsMutex);
+
+    // Oldest first, skipping jobs on channels the thief is not allowed to run
+    for (auto jobItr = m_jobs.begin(); jobItr != m_jobs.end(); ++jobItr)
+    {
+        Job *job = *jobItr;
+        if ((job->m_jobChannels & thiefJobChannels) != 0)
+        {
+            m_jobs.erase(jobItr);
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+size_t JobWorkerQueue::GetSize() const
+{
+    std::lock_guard<JobMutex> lock(m_jobsMutex);
+    return m_jobs.size();
+}
+
+bool JobWorkerQueue::IsEmpty() const
+{
+    std::lock_guard<JobMutex> lock(m_jobsMutex);
+    return m_jobs.empty();
+}
+
+std::deque<Job *> JobWorkerQueue::TakeAllJobs()
+{
+    std::lock_guard<JobMutex> lock(m_jobsMutex);
+    std::deque<Job *> jobs;
+    jobs.swap(m_jobs);
+    return jobs;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <mutex>
+#include <deque>
+#include "jobmutex.h"
+
+class Job;
+
+// Local job deque owned by one worker thread. The owner pushes and pops at the back
+// so it keeps working on what it just produced, idle workers steal from the front.
+class JobWorkerQueue
+{
+public:
+    JobWorkerQueue() = default;
+    ~JobWorkerQueue() = default;
+
+    void PushJob(Job *job);
+    Job *PopJob();
+    Job *StealJob(unsigned long thiefJobChannels);
+    bool IsEmpty() const;
+    size_t GetSize() const;
+
+    // Empties the queue, used when the owning worker is destroyed
+    std::deque<Job *> TakeAllJobs();
+
+private:
+    std::deque<Job *> m_jobs;
+    mutable JobMutex m_jobsMutex{"JobWorkerQueue::m_jobsMutex"};
+};
@@ -2,10 +2,18 @@
 #include "jobsystem.h"
 #include <iostream>
 
-JobWorkerThread::JobWorkerThread(const char *uniqueName, unsigned long workerJobChannels, JobSystem *jobSystem) : m_uniqueName(uniqueName),
-                                                                                                                  m_workerJobChannels(workerJobChannels),
-                                                                                                                  m_jobSystem(jobSystem)
+static thread_local JobWorkerThread *t_currentWorker = nullptr;
+
+JobWorkerThread::JobWorkerThread(const char *uniqueName, unsigned long workerJobChannels, JobSystem *jobSystem, JobElasticPool *elasticPool,
+                                 const JobWorkerPlacement &placement) : m_uniqueName(uniqueName),
+                                                                        m_workerJobChannels(workerJobChannels),
+                                                                        m_jobSystem(jobSystem),
+                                                                        m_placement(placement),
+                                                                        m_elasticPool(elasticPool),
+                                                                        m_localQueue(std::make_shared<JobWorkerQueue>())
 {
+    m_workerIndex = m_jobSystem->m_numWorkersCreated.fetch_add(1);
+    m_jobSystem->m_tracer.SetWorkerName(m_workerIndex, m_uniqueName);
 }
 
 JobWorkerThread::~JobWorkerThread()
@@ -29,59 +37,108 @@ void JobWorkerThread::Work()
     // While the thread is not signaled to stop, keep working
     while (!IsStopping())
     {
-        // Protect the worker status
-        std::lock_guard<std::mutex> lock(m_workerStatusMutex);
-        unsigned long workerJobChannels = m_workerJobChannels;
+        // Read the channels under the lock, but never hold it while running or waiting so ShutDown() can get in
+        unsigned long workerJobChannels = 0;
+        {
+            std::lock_guard<JobMutex> lock(m_workerStatusMutex);
+            workerJobChannels = m_workerJobChannels;
+        }
+
+        // Remember the generation before looking, anything queued after this point will wake us
+        unsigned long long seenGeneration = m_jobSystem->GetJobsAvailableGeneration();
 
-        // Claim a job from the queue
-        Job *job = m_jobSystem->ClaimAJob(m_workerJobChannels);
+        // Claim a job from our own queue, the global queue or another worker,
+        // jobs only reach a queue once all of their dependencies have completed
+        Job *job = m_jobSystem->ClaimAJob(this, workerJobChannels);
         if (job)
         {
-            // Execute only if dependencies are met
-            if (m_jobSystem->AreDependenciesResolved(job->GetUniqueID()))
+            // Busy from the claim until the job is handed back, it may be deleted once it is
+            JobTimeline::TimePoint busyStartTime = job->m_timeline.m_claimedTime;
+
+            // Call the execute function of the job, unless it was cancelled while it waited
+            if (job->IsCancelled())
             {
-                // Call the execute function of the job
-                job->Execute();
-                // Signal the jobsystem that the job is done and ready to be cleaned up
-                m_jobSystem->OnJobCompleted(job);
+                m_jobSystem->SetCancelledOutput(job);
             }
             else
             {
-                // If dependencies are not resolved, re-queue the job
-                m_jobSystem->QueueJob(job->GetUniqueID());
-                // Wait for a short duration before attempting to claim a job again
-                // This prevents the thread from spinning too quickly and re-claiming the same job
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                job->m_timeline.m_executeStartTime = JobTimeline::Now();
+                job->Execute();
+                job->m_timeline.m_executeEndTime = JobTimeline::Now();
             }
+            // Signal the jobsystem that the job is done and ready to be cleaned up, or parked if it deferred its completion
+            m_jobSystem->OnJobExecuted(job);
+
+            m_busyNanoseconds.fetch_add(std::chrono::nanoseconds(JobTimeline::Now() - busyStartTime).count(), std::memory_order_relaxed);
+            m_numJobsExecuted.fetch_add(1, std::memory_order_relaxed);
         }
+        else
+        {
+            // Nothing we can run, sleep until a job is queued or completed instead of polling.
+            // Elastic workers only wait so long, then hand their thread back if the pool can spare them
+            JobTimeline::TimePoint idleStartTime = JobTimeline::Now();
+            bool isWoken = m_jobSystem->WaitForJobsAvailable(seenGeneration, this, workerJobChannels);
+            m_idleNanoseconds.fetch_add(std::chrono::nanoseconds(JobTimeline::Now() - idleStartTime).count(), std::memory_order_relaxed);
 
-        // If no job was claimed, wait for a short duration before trying again
-        // This reduces the chance of busy-waiting if the job queue is empty
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (!isWoken && m_jobSystem->RetireElasticWorker(this))
+            {
+                return;
+            }
+        }
     }
 }
 
 void JobWorkerThread::ShutDown()
 {
-    std::lock_guard<std::mutex> lock(m_workerStatusMutex);
-    m_isStopping = true;
+    {
+        std::lock_guard<JobMutex> lock(m_workerStatusMutex);
+        m_isStopping = true;
+    }
+
+    // Wake the worker in case it is waiting for jobs
+    m_jobSystem->WakeWorker(this);
 }
 
 bool JobWorkerThread::IsStopping() const
 {
-    std::lock_guard<std::mutex> lock(m_workerStatusMutex);
+    std::lock_guard<JobMutex> lock(m_workerStatusMutex);
     bool shouldClose = m_isStopping;
     return shouldClose;
 }
 
 void JobWorkerThread::SetWorkerJobChannels(unsigned long workerJobChannels)
 {
-    std::lock_guard<std::mutex> lock(m_workerStatusMutex);
-    m_workerJobChannels = workerJobChannels;
+    {
+        std::lock_guard<JobMutex> lock(m_workerStatusMutex);
+        m_workerJobChannels = workerJobChannels;
+    }
+
+    // An idle worker waits for jobs on the channels it had, let it look again with the new ones
+    m_jobSystem->WakeWorker(this);
+}
+
+unsigned long JobWorkerThread::GetWorkerJobChannels() const
+{
+    std::lock_guard<JobMutex> lock(m_workerStatusMutex);
+    return m_workerJobChannels;
 }
 
 void JobWorkerThread::WorkerThreadMain(void *workerThreadObject)
 {
     JobWorkerThread *thisWorker = (JobWorkerThread *)workerThreadObject;
+    t_currentWorker = thisWorker;
+
+    // Pin from the thread itself, before it touches any job memory
+    if (thisWorker->m_placement.IsPinned() && !JobTopology::PinCurrentThread(JobTopology::ResolveCores(thisWorker->m_placement)))
+    {
+        std::cerr << "Could not pin worker thread " << thisWorker->m_uniqueName << ", leaving it unpinned" << std::endl;
+    }
+
     thisWorker->Work();
+    t_currentWorker = nullptr;
+}
+
+JobWorkerThread *JobWorkerThread::GetCurrentWorker()
+{
+    return t_currentWorker;
 }
\ No newline at end of file
@@ -4,10 +4,17 @@
 #include <deque>
 #include <vector>
 #include <thread>
+#include <memory>
+#include <string>
+#include <atomic>
 
 #include "job.h"
+#include "jobmutex.h"
+#include "jobworkerqueue.h"
+#include "jobtopology.h"
 
 class JobSystem;
+struct JobElasticPool;
 
 class JobWorkerThread
 {
@@ -15,7 +22,8 @@ class JobWorkerThread
 
     // Only job system should be affecting this stuff
 private:
-    JobWorkerThread(const char *uniqueName, unsigned long workerJobChannels, JobSystem *jobSystem);
+    JobWorkerThread(const char *uniqueName, unsigned long workerJobChannels, JobSystem *jobSystem, JobElasticPool *elasticPool = nullptr,
+                    const JobWorkerPlacement &placement = JobWorkerPlacement());
     ~JobWorkerThread();
 
     void StartUp();  // Kick off actual thread, which will call Work()
@@ -24,13 +32,45 @@ private:
 
     bool IsStopping() const;
     void SetWorkerJobChannels(unsigned long workerJobChannels);
+    unsigned long GetWorkerJobChannels() const;
     static void WorkerThreadMain(void *workerThreadObject);
 
+    // Worker running on the calling thread, nullptr when called from a non-worker thread
+    static JobWorkerThread *GetCurrentWorker();
+
 private:
-    const char *m_uniqueName;
+    std::string m_uniqueName;
+    // Unique within the job system, unlike the name of an elastic worker that retired and came back
+    int m_workerIndex = 0;
     unsigned long m_workerJobChannels = 0xffffffff;
     bool m_isStopping = false;
     JobSystem *m_jobSystem = nullptr;
     std::thread *m_thread = nullptr;
-    mutable std::mutex m_workerStatusMutex;
+    mutable JobMutex m_workerStatusMutex{"JobWorkerThread::m_workerStatusMutex"};
+
+    // Cores the thread pins itself to when it starts
+    JobWorkerPlacement m_placement;
+
+    // Set for workers the job system starts and retires on demand
+    JobElasticPool *m_elasticPool = nullptr;
+
+    // Shared with the job system so other workers can steal from it
+    std::shared_ptr<JobWorkerQueue> m_localQueue;
+
+    // Idle wakeup, only touched under the job system's jobs available lock. A released job wakes one
+    // idle worker that serves its channels instead of every idle worker
+    JobConditionVariable m_jobsAvailableCondition;
+    unsigned long m_idleJobChannels = 0;
+    bool m_isNotified = false;
+
+    // Only the worker adds to these, metrics snapshots read them while it runs
+    std::atomic<long long> m_busyNanoseconds{0};
+    std::atomic<long long> m_idleNanoseconds{0};
+    std::atomic<unsigned long long> m_numJobsExecuted{0};
+
+    // Which of the job system's channel queues this worker may take from, only touched under
+    // the job system's queued lock and rebuilt when the channels or the set of queues change
+    unsigned long long m_channelQueueMask = 0;
+    unsigned long m_channelQueueMaskChannels = 0;
+    unsigned long long m_channelQueueMaskGeneration = 0;
 };
@@ -0,0 +1,79 @@
+#include "processjob.h"
+#include "jobsystem.h"
+#include <iostream>
+
+void ProcessJob::Execute()
+{
+    std::string command = GetCommand();
+    if (command.empty())
+    {
+        return;
+    }
+
+    if (GetJobSystem() == nullptr)
+    {
+        OnSpawnFailed("job was not created by a JobSystem");
+        return;
+    }
+
+    // The worker is free as soon as we return, the reactor completes the job when the child is done.
+    // Deferred before spawning, the child may exit before SpawnProcess returns, and the job may be
+    // deleted by then, so the process ID is stored and a cancel that came in while spawning is
+    // checked for before the reactor watches the child
+    DeferCompletion();
+    std::string spawnError;
+    pid_t processID = GetJobSystem()->GetReactor().SpawnProcess(command, [this](const std::string &output, int exitCode)
+                                                                {
+                                                                    SetExitCode(exitCode);
+                                                                    OnProcessExit(output, exitCode);
+                                                                    CompleteDeferred(); },
+                                                                spawnError,
+                                                                [this](pid_t spawnedProcessID)
+                                                                {
+                                                                    m_processID.store(spawnedProcessID);
+                                                                    return !IsCancelled(); });
+    if (processID < 0)
+    {
+        SetExitCode(-1);
+        OnSpawnFailed(spawnError);
+        CompleteDeferred();
+    }
+}
+
+void ProcessJob::OnCancel()
+{
+    pid_t processID = m_processID.load();
+    if (processID > 0)
+    {
+        GetJobSystem()->GetReactor().TerminateProcess(processID);
+    }
+}
+
+std::string ProcessJob::GetCommand()
+{
+    Payload input = GetInput();
+    if (!input->is_object() || !input->contains("command") || !(*input)["command"].is_string())
+    {
+        return std::string();
+    }
+    return (*input)["command"].get<std::string>();
+}
+
+void ProcessJob::OnProcessExit(const std::string &output, int exitCode)
+{
+    nlohmann::json jsonOutput;
+    jsonOutput["status"] = IsCancelled() ? "cancelled" : "completed";
+    jsonOutput["exitCode"] = exitCode;
+    jsonOutput["output"] = output;
+    SetOutput(std::move(jsonOutput));
+}
+
+void ProcessJob::OnSpawnFailed(const std::string &reason)
+{
+    std::cerr << "Process Job " << GetUniqueID() << ": " << reason << std::endl;
+
+    nlohmann::json jsonOutput;
+    jsonOutput["status"] = "failed to start";
+    jsonOutput["error"] = reason;
+    SetOutput(std::move(jsonOutput));
+}
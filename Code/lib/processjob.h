@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <sys/types.h>
+#include "job.h"
+
+// Runs a shell command without holding a worker while the child runs. Execute() spawns the child with
+// stdout and stderr on one pipe, hands the pipe to the job system's reactor and returns; the job completes
+// on the reactor thread once the child has exited and all of its output has been read.
+class ProcessJob : public Job
+{
+public:
+    ProcessJob(unsigned long jobChannels = JOB_CHANNEL_IO) : Job(jobChannels) {}
+    virtual ~ProcessJob() {}
+
+    void Execute() override;
+
+protected:
+    // Command run through /bin/sh, by default the "command" key of the input. An empty command skips the run
+    virtual std::string GetCommand();
+
+    // Called on the reactor thread with everything the child wrote, sets the job's output by default
+    virtual void OnProcessExit(const std::string &output, int exitCode);
+
+    // Set if the child could not be started, the job completes right away with it as the output
+    virtual void OnSpawnFailed(const std::string &reason);
+
+    // Terminates the child, OnProcessExit() then sees it exit with 128 + the signal
+    void OnCancel() override;
+
+    pid_t GetProcessID() const { return m_processID.load(); }
+
+private:
+    std::atomic<pid_t> m_processID{-1};
+};
@@ -4,6 +4,8 @@
 #include "./lib/jobsystemapi.h"
 #include "utils.h"
 #include "flowscriptparser.h"
+#include "correctionjob.h"
+#include "pipelinelatency.h"
 
 int main(int argc, char *argv[])
 {
@@ -13,6 +15,12 @@ int main(int argc, char *argv[])
     // Start the job system
     jobSystem.Start();
 
+    // Job callbacks pretty-print whole outputs, keep that off the workers and the thread driving the loop
+    jobSystem.SetCallbackMode(JOB_CALLBACK_THREAD);
+
+    // Every job of the run goes into a trace, so queue waits and execution times can be compared across the fix loop
+    jobSystem.StartTrace();
+
     // Parse command line arguments
     std::string filePathArg;
     if (argc > 1)
@@ -25,6 +33,12 @@ int main(int argc, char *argv[])
         throw std::runtime_error("No file path argument provided");
     }
 
+    // Splits every pass of the loop into the time its stages ran and the time they waited, the first
+    // pass is the FlowScript generation
+    std::string latencyReportPath = "./Data/pipeline_latency.json";
+    PipelineLatencyReport latencyReport;
+    latencyReport.BeginPass("generate");
+
     // Construct the command for flowscriptGenJobInput
     std::string command = "node ./Code/flowScriptGen.js -files " + filePathArg;
 
@@ -40,10 +54,13 @@ int main(int argc, char *argv[])
 
     std::cout << "Queuing flowscriptGenJob: \n"
               << std::endl;
-    jobSystem.QueueJob(flowscriptGenJobCreation["jobId"]);
+    JobHandle flowscriptGenJobHandle = jobSystem.QueueJob(flowscriptGenJobCreation["jobId"]);
 
-    // Introducing delay to wait for flowscript.dot file to be created
-    std::this_thread::sleep_for(std::chrono::seconds(15));
+    // Wait for the generator to exit, flowscript.dot has been written by then
+    PipelineLatencyReport::TimePoint waitStartTime = std::chrono::steady_clock::now();
+    nlohmann::json flowscriptGenFinish = jobSystem.FinishJob(flowscriptGenJobHandle);
+    latencyReport.RecordStage(flowscriptGenFinish, waitStartTime);
+    latencyReport.EndPass();
 
     // Register flowscript parse job type
     std::cout << "Registering custom flowscript parsing job\n"
@@ -51,6 +68,21 @@ int main(int argc, char *argv[])
     jobSystem.RegisterJob("flowscriptJob", [&jobSystem]() -> Job *
                           { return new FlowScriptParseJob(&jobSystem); });
 
+    // Registered once for every fix iteration that still has compilation errors.
+    // Only waits on its subprocesses, so it stays on the CPU channel without holding a worker
+    std::cout << "Registering correction Job\n"
+              << std::endl;
+    jobSystem.RegisterJob("correctionJob", [&jobSystem]() -> Job *
+                          { return new CorrectionJob(&jobSystem); });
+
+    // A transient LLM failure reruns just this job after a few seconds, not the whole fix iteration.
+    // A failed patch is left to the next iteration, retrying it would repeat the LLM call too
+    JobRetryPolicy correctionRetryPolicy;
+    correctionRetryPolicy.m_maxAttempts = 3;
+    correctionRetryPolicy.m_initialBackoff = std::chrono::milliseconds(2000);
+    correctionRetryPolicy.m_retryableExitCodes = {CorrectionJob::EXIT_GPT_CALL_FAILED};
+    jobSystem.SetRetryPolicy("correctionJob", correctionRetryPolicy);
+
     // Read in the file here and create JSON object input
     std::string errorReportPath = "./Data/error_report.json";
 
@@ -71,9 +103,15 @@ int main(int argc, char *argv[])
     dotFile.close();
 
     // Begin execution of FlowScript and loop until no compilation errors
+    int fixIteration = 0;
     while (true)
     {
-        runFlowScript(jobSystem, flowscriptText);
+        latencyReport.BeginPass("fix " + std::to_string(++fixIteration));
+        runFlowScript(jobSystem, flowscriptText, latencyReport);
+        latencyReport.EndPass();
+
+        // Rewritten every pass next to error_report.json, so it is there even if the loop never ends
+        latencyReport.Write(latencyReportPath);
 
         if (!hasCompilationErrors(errorReportPath))
         {
@@ -82,6 +120,16 @@ int main(int argc, char *argv[])
         }
     }
 
+    std::cout << "Job system metrics: " << jobSystem.GetMetrics().dump(4) << std::endl;
+    std::cout << "Pipeline latency over " << fixIteration << " fix iterations, per pass in " << latencyReportPath << ": "
+              << latencyReport.ToJson()["totals"].dump(4) << std::endl;
+
+    // Only finished jobs make it into the trace, runFlowScript finishes everything it queues
+    if (jobSystem.WriteTrace("./Data/job_trace.json"))
+    {
+        std::cout << "Job trace written to ./Data/job_trace.json" << std::endl;
+    }
+
     std::cout << "Execution complete!\nDestroying the Job System.\n"
               << std::endl;
 
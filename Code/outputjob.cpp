@@ -1,4 +1,5 @@
 #include "outputjob.h"
+#include "./lib/jobsystem.h"
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -24,70 +25,44 @@ void OutputJob::Execute()
         return;
     }
 
-    nlohmann::json inputJson = this->GetInput();
+    // Shared with the parse job that produced it, read in place rather than copied
+    Payload inputJson = this->GetInput();
 
-    // converting parsed error information to JSON format and populating errorJson
-    for (const auto &errorInfo : inputJson)
+    // Errors are independent, so their entries and code snippets are built in parallel into their own
+    // slots, then grouped by file in the original order
+    std::vector<const nlohmann::json *> errorInfos;
+    for (const auto &errorInfo : *inputJson)
     {
-        // Extract error info from the JSON object
-        int lineNumber = errorInfo["lineNumber"];
-        int columnNumber = errorInfo["columnNumber"];
-        std::string description = errorInfo["description"];
-        std::string filepath = errorInfo["filepath"];
+        errorInfos.push_back(&errorInfo);
+    }
+    std::vector<ordered_json> errorEntries(errorInfos.size());
+
+    auto buildErrorEntries = [&errorInfos, &errorEntries](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            errorEntries[i] = BuildErrorEntry(*errorInfos[i]);
+        }
+    };
 
-        ordered_json errorEntry;
-        errorEntry["lineNumber"] = lineNumber;
-        errorEntry["columnNumber"] = columnNumber;
-        errorEntry["errorDescription"] = description;
+    // Each entry opens its source file, a handful per chunk is enough to be worth a worker
+    const size_t errorsPerChunk = 8;
+    if (GetJobSystem() != nullptr)
+    {
+        GetJobSystem()->ParallelFor(0, errorInfos.size(), errorsPerChunk, buildErrorEntries);
+    }
+    else
+    {
+        buildErrorEntries(0, errorInfos.size());
+    }
 
+    {
         // locking errorJson to prevent threads from writing to it at same time
         std::lock_guard<std::mutex> lockError(m_errorJsonMutex);
-
-        // Adding code snippets before and after error line
-        // std::string codeSnippet;
-        ordered_json codeSnippetArray;
-        int errorLineNumber = lineNumber;
-        const int linesBeforeError = 2;
-        const int linesAfterError = 2;
-
-        // Opening source file
-        if (filepath != "Linker Error")
+        for (size_t i = 0; i < errorInfos.size(); ++i)
         {
-            std::ifstream sourceFile(filepath);
-            if (sourceFile.is_open())
-            {
-                int currentLineNumber = 0;
-                std::string line;
-
-                // Reading lines from the source file
-                while (std::getline(sourceFile, line))
-                {
-                    currentLineNumber++;
-
-                    // Edge cases
-                    if ((currentLineNumber > errorLineNumber + linesAfterError) || errorLineNumber == 0)
-                    {
-                        break;
-                    }
-
-                    // Checking current line is in desired range around error line
-                    if (currentLineNumber >= (errorLineNumber - linesBeforeError) &&
-                        currentLineNumber <= (errorLineNumber + linesAfterError))
-                    {
-                        codeSnippetArray.push_back(line);
-                    }
-                }
-
-                sourceFile.close();
-            }
-            // Adding the code snippet to the JSON entry
-            errorEntry["codeSnippet"] = codeSnippetArray;
-
-            errorJson[filepath].push_back(errorEntry);
-        }
-        else
-        {
-            errorJson[filepath].push_back(errorEntry);
+            std::string filepath = (*errorInfos[i])["filepath"];
+            errorJson[filepath].push_back(std::move(errorEntries[i]));
         }
     }
 
@@ -100,9 +75,68 @@ void OutputJob::Execute()
     jsonFile.close();
 }
 
+ordered_json OutputJob::BuildErrorEntry(const nlohmann::json &errorInfo)
+{
+    // Extract error info from the JSON object
+    int lineNumber = errorInfo["lineNumber"];
+    int columnNumber = errorInfo["columnNumber"];
+    std::string description = errorInfo["description"];
+    std::string filepath = errorInfo["filepath"];
+
+    ordered_json errorEntry;
+    errorEntry["lineNumber"] = lineNumber;
+    errorEntry["columnNumber"] = columnNumber;
+    errorEntry["errorDescription"] = description;
+
+    // Linker errors have no source file to take a snippet from
+    if (filepath == "Linker Error")
+    {
+        return errorEntry;
+    }
+
+    // Adding code snippets before and after error line
+    ordered_json codeSnippetArray;
+    int errorLineNumber = lineNumber;
+    const int linesBeforeError = 2;
+    const int linesAfterError = 2;
+
+    // Opening source file
+    std::ifstream sourceFile(filepath);
+    if (sourceFile.is_open())
+    {
+        int currentLineNumber = 0;
+        std::string line;
+
+        // Reading lines from the source file
+        while (std::getline(sourceFile, line))
+        {
+            currentLineNumber++;
+
+            // Edge cases
+            if ((currentLineNumber > errorLineNumber + linesAfterError) || errorLineNumber == 0)
+            {
+                break;
+            }
+
+            // Checking current line is in desired range around error line
+            if (currentLineNumber >= (errorLineNumber - linesBeforeError) &&
+                currentLineNumber <= (errorLineNumber + linesAfterError))
+            {
+                codeSnippetArray.push_back(line);
+            }
+        }
+
+        sourceFile.close();
+    }
+
+    // Adding the code snippet to the JSON entry
+    errorEntry["codeSnippet"] = codeSnippetArray;
+    return errorEntry;
+}
+
 void OutputJob::JobCompleteCallback()
 {
     // Dumping JSON to console to verify JSON output
     std::cout << "JSON Output Job " << this->GetUniqueID() << " completed, the output is:" << std::endl;
-    std::cout << this->GetOutput().dump(4) << std::endl;
+    std::cout << this->GetOutput()->dump(4) << std::endl;
 }
\ No newline at end of file
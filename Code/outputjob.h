@@ -23,6 +23,9 @@ public:
     };
 
 private:
+    // One error's entry in the report, with the source lines around it
+    static nlohmann::ordered_json BuildErrorEntry(const nlohmann::json &errorInfo);
+
     nlohmann::json m_parseJobOutput;
     mutable std::mutex m_errorInfoVectorMutex;
     mutable std::mutex m_errorJsonMutex;
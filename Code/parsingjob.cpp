@@ -16,7 +16,8 @@ void ParsingJob::Execute()
     std::regex linker_error("clang: error: (.*)");
     std::regex compiler_error("(.*):(\\d+):(\\d+): (?:error|warning): (.*)");
 
-    std::istringstream err(this->GetInput()["output"].get<std::string>());
+    Payload input = this->GetInput();
+    std::istringstream err((*input)["output"].get<std::string>());
 
     std::string line;
     std::string linker_snippet;
@@ -40,10 +41,10 @@ void ParsingJob::Execute()
         else if (std::regex_match(line, match, compiler_error))
         {
             ErrorInfo errorInfo = {
+                .description = match[4],
                 .filepath = match[1],
                 .lineNumber = std::stoi(match[2]),
                 .columnNumber = std::stoi(match[3]),
-                .description = match[4],
             };
             m_parsedErrors.push_back(errorInfo);
         }
@@ -58,10 +59,10 @@ void ParsingJob::Execute()
     {
         std::string filePath = "Linker Error";
         ErrorInfo errorInfo = {
+            .description = linker_snippet,
             .filepath = filePath,
             .lineNumber = 0,
             .columnNumber = 0,
-            .description = linker_snippet,
         };
         m_parsedErrors.push_back(errorInfo);
     }
@@ -79,12 +80,12 @@ void ParsingJob::Execute()
         jsonOutput.push_back(errorJson);
     }
 
-    this->SetOutput(jsonOutput);
+    this->SetOutput(std::move(jsonOutput));
 }
 
 void ParsingJob::JobCompleteCallback()
 {
     std::cout << "Parsing Job " << this->GetUniqueID() << " has been completed, the output is:" << std::endl;
-    std::string jsonOuput = this->GetOutput().dump(4);
+    std::string jsonOuput = this->GetOutput()->dump(4);
     std::cout << jsonOuput << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "pipelinelatency.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+// Same clock and unit as the job timelines FinishJob() returns
+static double ToSteadyMilliseconds(PipelineLatencyReport::TimePoint timePoint)
+{
+    return std::chrono::duration<double, std::milli>(timePoint.time_since_epoch()).count();
+}
+
+static double GetPercent(double part, double whole)
+{
+    return (whole > 0.0) ? (100.0 * part) / whole : 0.0;
+}
+
+void PipelineLatencyReport::BeginPass(const std::string &passName)
+{
+    m_pass = nlohmann::json::object();
+    m_pass["pass"] = passName;
+    m_pass["stages"] = nlohmann::json::array();
+    m_passStartTime = std::chrono::steady_clock::now();
+    m_mainThreadWaitingMs = 0.0;
+    m_runningIntervals.clear();
+}
+
+void PipelineLatencyReport::EndPass()
+{
+    double passStartMs = ToSteadyMilliseconds(m_passStartTime);
+    double passEndMs = ToSteadyMilliseconds(std::chrono::steady_clock::now());
+    double wallMs = passEndMs - passStartMs;
+
+    // Stages of one pass overlap when they do not depend on each other, only count that time once
+    std::sort(m_runningIntervals.begin(), m_runningIntervals.end());
+    double activeMs = 0.0;
+    double coveredUntilMs = passStartMs;
+    for (const auto &interval : m_runningIntervals)
+    {
+        double startMs = std::max(interval.first, coveredUntilMs);
+        double endMs = std::min(interval.second, passEndMs);
+        if (endMs > startMs)
+        {
+            activeMs += endMs - startMs;
+            coveredUntilMs = endMs;
+        }
+    }
+
+    m_pass["wallMs"] = wallMs;
+    m_pass["activeMs"] = activeMs;
+    m_pass["idleMs"] = wallMs - activeMs;
+    m_pass["idlePercent"] = GetPercent(wallMs - activeMs, wallMs);
+    // Blocked in FinishJob() versus reading files and submitting the graph in between
+    m_pass["mainThread"]["waitingOnJobsMs"] = m_mainThreadWaitingMs;
+    m_pass["mainThread"]["otherMs"] = wallMs - m_mainThreadWaitingMs;
+
+    m_passes.push_back(std::move(m_pass));
+    m_pass = nlohmann::json();
+}
+
+void PipelineLatencyReport::RecordStage(const nlohmann::json &finishResponse, TimePoint waitStartTime,
+                                        const nlohmann::json &steps)
+{
+    double finishedMs = ToSteadyMilliseconds(std::chrono::steady_clock::now());
+    double waitStartMs = ToSteadyMilliseconds(waitStartTime);
+    m_mainThreadWaitingMs += finishedMs - waitStartMs;
+
+    // Nothing to split for a job FinishJob() could not find
+    if (!finishResponse.contains("timeline"))
+    {
+        return;
+    }
+
+    // A cancelled job may have skipped stages, those take no time
+    const nlohmann::json &timeline = finishResponse["timeline"];
+    double createdMs = timeline.value("createdMs", waitStartMs);
+    double queuedMs = timeline.value("queuedMs", createdMs);
+    double releasedMs = timeline.value("releasedMs", queuedMs);
+    double completedMs = timeline.value("completedMs", finishedMs);
+    double claimedMs = timeline.value("claimedMs", completedMs);
+
+    double wallMs = finishedMs - createdMs;
+    double activeMs = completedMs - claimedMs;
+    m_runningIntervals.emplace_back(claimedMs, completedMs);
+
+    nlohmann::json stage;
+    stage["stage"] = finishResponse.value("jobType", "");
+    stage["attempt"] = finishResponse.value("attempt", 1);
+    stage["wallMs"] = wallMs;
+    stage["activeMs"] = activeMs;
+    stage["waitingMs"] = wallMs - activeMs;
+    // Created until queued also holds every failed attempt and its backoff for a retried job
+    stage["waiting"]["toBeQueuedMs"] = queuedMs - createdMs;
+    stage["waiting"]["onDependenciesMs"] = releasedMs - queuedMs;
+    stage["waiting"]["forWorkerMs"] = claimedMs - releasedMs;
+    stage["waiting"]["toBeCollectedMs"] = finishedMs - completedMs;
+    if (!steps.is_null())
+    {
+        stage["steps"] = steps;
+    }
+    m_pass["stages"].push_back(std::move(stage));
+}
+
+nlohmann::json PipelineLatencyReport::ToJson() const
+{
+    double wallMs = 0.0;
+    double activeMs = 0.0;
+    for (const nlohmann::json &pass : m_passes)
+    {
+        wallMs += pass["wallMs"].get<double>();
+        activeMs += pass["activeMs"].get<double>();
+    }
+
+    nlohmann::json report;
+    report["passes"] = m_passes;
+    report["totals"]["wallMs"] = wallMs;
+    report["totals"]["activeMs"] = activeMs;
+    report["totals"]["idleMs"] = wallMs - activeMs;
+    report["totals"]["idlePercent"] = GetPercent(wallMs - activeMs, wallMs);
+    return report;
+}
+
+bool PipelineLatencyReport::Write(const std::string &reportPath) const
+{
+    std::ofstream reportFile(reportPath, std::ios::out | std::ios::trunc);
+    if (!reportFile.is_open())
+    {
+        std::cerr << "ERROR: Failed to open the pipeline latency report for writing: " << reportPath << std::endl;
+        return false;
+    }
+
+    reportFile << ToJson().dump(4) << std::endl;
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+#include <nlohmann/json.hpp>
+
+// Where the wall-clock time of the compile-fix loop goes, pass by pass. Every stage is a job the main
+// thread waits on with FinishJob(), and the timeline in its response splits the stage into the time it
+// was running, on a worker or in its subprocess, and the time it only waited: to be queued, on its
+// dependencies, for a worker, and for its callback and the main thread to collect it.
+// For a whole pass, the time at least one stage was running is active, the rest is idle time the loop
+// spends between stages
+class PipelineLatencyReport
+{
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    // Stages recorded until EndPass() belong to this pass
+    void BeginPass(const std::string &passName);
+    void EndPass();
+
+    // finishResponse is what FinishJob() returned for the stage's job, waitStartTime when the main
+    // thread called it. Steps, e.g. the scripts of the correction job, split the active time further
+    void RecordStage(const nlohmann::json &finishResponse, TimePoint waitStartTime,
+                     const nlohmann::json &steps = nlohmann::json());
+
+    // Every finished pass and the totals over all of them
+    nlohmann::json ToJson() const;
+    bool Write(const std::string &reportPath) const;
+
+private:
+    nlohmann::json m_passes = nlohmann::json::array();
+
+    // Pass in progress
+    nlohmann::json m_pass;
+    TimePoint m_passStartTime;
+    double m_mainThreadWaitingMs = 0.0;
+    // Claimed until completed, in steady clock milliseconds, of every stage of the pass
+    std::vector<std::pair<double, double>> m_runningIntervals;
+};
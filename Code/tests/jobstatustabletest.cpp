@@ -0,0 +1,91 @@
+#include <iostream>
+#include <string>
+#include "../lib/jobstatustable.h"
+
+// Exits non-zero on the first status that reads wrong
+static int s_numFailures = 0;
+
+static void Expect(bool condition, const std::string &description)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << description << std::endl;
+        ++s_numFailures;
+    }
+}
+
+// One job stays queued while more IDs than the ring holds go through, as a posted job nobody
+// finishes would. Its segment has to be let go without losing its status or anyone else's
+static void TestLongLivedJobOutlivesRing()
+{
+    JobStatusTable statusTable;
+    const JobID longLivedJobID = 5;
+    const JobID numCycledJobs = 2 * JobStatusTable::RING_CAPACITY + 1000;
+
+    statusTable.SetJobStatus(longLivedJobID, JOB_STATUS_QUEUED);
+    for (JobID jobID = 0; jobID < numCycledJobs; ++jobID)
+    {
+        if (jobID == longLivedJobID)
+        {
+            continue;
+        }
+        statusTable.SetJobStatus(jobID, JOB_STATUS_RUNNING);
+        statusTable.RetireJob(jobID);
+    }
+
+    Expect(statusTable.GetLowestActiveIndex() > longLivedJobID, "the long-lived job's segment was let go");
+    Expect(statusTable.GetNumLongLivedJobs() == 1, "only the long-lived job is kept outside the ring");
+    Expect(statusTable.GetJobStatus(longLivedJobID) == JOB_STATUS_QUEUED, "the long-lived job is still queued");
+    Expect(statusTable.GetJobStatus(longLivedJobID + 1) == JOB_STATUS_RETIRED, "its neighbour reads retired");
+
+    // New IDs are tracked as usual instead of reading as never seen
+    JobID newJobID = numCycledJobs;
+    statusTable.SetJobStatus(newJobID, JOB_STATUS_QUEUED);
+    Expect(statusTable.GetJobStatus(newJobID) == JOB_STATUS_QUEUED, "a new job is tracked once the ring has wrapped");
+    Expect(statusTable.GetJobStatus(newJobID + 1) == JOB_STATUS_NEVER_SEEN, "an unused ID reads never seen");
+
+    // The long-lived job can still move on and retire
+    statusTable.SetJobStatus(longLivedJobID, JOB_STATUS_RUNNING);
+    Expect(statusTable.GetJobStatus(longLivedJobID) == JOB_STATUS_RUNNING, "the long-lived job can start running");
+    statusTable.RetireJob(longLivedJobID);
+    Expect(statusTable.GetJobStatus(longLivedJobID) == JOB_STATUS_RETIRED, "the long-lived job retires");
+    Expect(statusTable.GetNumLongLivedJobs() == 0, "nothing is left outside the ring");
+}
+
+// Every segment keeps one job that never retires, so every segment the ring comes back around to is
+// evicted instead of reclaimed. The evicted segments are reused, the ring does not grow past its size
+static void TestEvictedSegmentsAreRecycled()
+{
+    JobStatusTable statusTable;
+    const JobID numCycledJobs = 2 * JobStatusTable::RING_CAPACITY;
+
+    for (JobID jobID = 0; jobID < numCycledJobs; ++jobID)
+    {
+        statusTable.SetJobStatus(jobID, JOB_STATUS_RUNNING);
+        if ((jobID % JobStatusTable::SEGMENT_SIZE) != 0)
+        {
+            statusTable.RetireJob(jobID);
+        }
+    }
+
+    Expect(statusTable.GetNumSegments() <= (size_t)JobStatusTable::MAX_SEGMENTS + 1, "evicted segments are reused");
+    Expect(statusTable.GetJobStatus(0) == JOB_STATUS_RUNNING, "the first evicted job is still running");
+    Expect(statusTable.GetJobStatus(JobStatusTable::SEGMENT_SIZE + 1) == JOB_STATUS_RETIRED, "a retired job reads retired");
+    JobID lastLongLivedJobID = numCycledJobs - JobStatusTable::SEGMENT_SIZE;
+    Expect(statusTable.GetJobStatus(lastLongLivedJobID) == JOB_STATUS_RUNNING, "a job in a reused segment is running");
+    Expect(statusTable.GetJobStatus(lastLongLivedJobID + 1) == JOB_STATUS_RETIRED, "its neighbour reads retired");
+}
+
+int main()
+{
+    TestLongLivedJobOutlivesRing();
+    TestEvictedSegmentsAreRecycled();
+
+    if (s_numFailures > 0)
+    {
+        std::cerr << s_numFailures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "jobstatustabletest passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include "../lib/jobsystem.h"
+#include "../lib/job.h"
+
+// Exits non-zero on the first job that runs out of order
+static int s_numFailures = 0;
+
+static void Expect(bool condition, const std::string &description)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << description << std::endl;
+        ++s_numFailures;
+    }
+}
+
+// Names of the jobs in the order they ran
+static std::vector<std::string> s_executedJobs;
+static std::mutex s_executedJobsMutex;
+
+class RecordingJob : public Job
+{
+public:
+    void Execute() override
+    {
+        std::lock_guard<std::mutex> lock(s_executedJobsMutex);
+        s_executedJobs.push_back(GetJobName());
+    }
+};
+
+// Long enough that a chain of them keeps a worker busy past the aging steps
+class SlowRecordingJob : public RecordingJob
+{
+public:
+    void Execute() override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        RecordingJob::Execute();
+    }
+};
+
+// C depends on A and B, but A finishes before C is told about B. C must not run off A alone,
+// it waits for QueueJob and then for B
+static void TestDependentWaitsForQueueJob()
+{
+    JobSystem *jobSystem = new JobSystem();
+    jobSystem->CreateWorkerThread("Test Thread 0");
+    jobSystem->RegisterJobType("record", []()
+                               { return new RecordingJob(); });
+
+    JobRunID runID = jobSystem->CreateGraphRun();
+    nlohmann::json input = nlohmann::json::object();
+    JobID jobA = jobSystem->CreateJob("record", input, runID, "A")["jobId"].get<JobID>();
+    JobID jobB = jobSystem->CreateJob("record", input, runID, "B")["jobId"].get<JobID>();
+    JobID jobC = jobSystem->CreateJob("record", input, runID, "C")["jobId"].get<JobID>();
+
+    jobSystem->SetDependency(runID, "C", "A");
+    jobSystem->QueueJob(jobA).Wait();
+    // Long enough for a wrongly released C to have run
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    {
+        std::lock_guard<std::mutex> lock(s_executedJobsMutex);
+        Expect(s_executedJobs == std::vector<std::string>({"A"}), "C does not run before QueueJob");
+    }
+
+    jobSystem->SetDependency(runID, "C", "B");
+    JobHandle handleC = jobSystem->QueueJob(jobC);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Expect(!handleC.IsComplete(), "C still waits on B once queued");
+
+    JobHandle handleB = jobSystem->QueueJob(jobB);
+    handleC.Wait();
+
+    {
+        std::lock_guard<std::mutex> lock(s_executedJobsMutex);
+        Expect(s_executedJobs == std::vector<std::string>({"A", "B", "C"}), "A, B and C run in dependency order");
+    }
+
+    jobSystem->FinishJob(jobA);
+    jobSystem->FinishJob(handleB);
+    jobSystem->FinishJob(handleC);
+    delete jobSystem;
+}
+
+// A single worker runs a dependency chain, every link released onto its local queue by the one
+// before. A low priority job queued meanwhile waits in the global queues and has to age past the
+// chain's local work instead of waiting for the chain to end
+static void TestLowPriorityJobOvertakesLocalWork()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_executedJobsMutex);
+        s_executedJobs.clear();
+    }
+
+    JobSystem *jobSystem = new JobSystem();
+    jobSystem->CreateWorkerThread("Test Thread 0");
+    jobSystem->RegisterJobType("slow", []()
+                               { return new SlowRecordingJob(); });
+
+    // Two milliseconds a link, the chain outlasts the two aging steps of a low priority job
+    const int numChainJobs = 600;
+    JobRunID runID = jobSystem->CreateGraphRun();
+    nlohmann::json input = nlohmann::json::object();
+    std::vector<JobID> chainJobs;
+    for (int i = 0; i < numChainJobs; ++i)
+    {
+        std::string jobName = "chain" + std::to_string(i);
+        chainJobs.push_back(jobSystem->CreateJob("slow", input, runID, jobName)["jobId"].get<JobID>());
+        if (i > 0)
+        {
+            jobSystem->SetDependency(runID, jobName, "chain" + std::to_string(i - 1));
+        }
+    }
+    std::vector<JobHandle> chainHandles;
+    for (JobID chainJob : chainJobs)
+    {
+        chainHandles.push_back(jobSystem->QueueJob(chainJob));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    nlohmann::json lowInput = {{"priority", "low"}};
+    JobHandle lowHandle = jobSystem->QueueJob(jobSystem->CreateJob("slow", lowInput, runID, "low")["jobId"].get<JobID>());
+    chainHandles.back().Wait();
+    lowHandle.Wait();
+
+    {
+        std::lock_guard<std::mutex> lock(s_executedJobsMutex);
+        Expect(s_executedJobs.back() != "low", "the low priority job runs before the chain ends");
+    }
+
+    for (const JobHandle &chainHandle : chainHandles)
+    {
+        jobSystem->FinishJob(chainHandle);
+    }
+    jobSystem->FinishJob(lowHandle);
+    delete jobSystem;
+}
+
+// Cancelling the first job of a long chain cancels every job after it, without a stack frame per job.
+// There are no workers, so nothing runs or completes while the chain is cancelled
+static void TestCancelLongChain()
+{
+    JobSystem *jobSystem = new JobSystem();
+    jobSystem->RegisterJobType("record", []()
+                               { return new RecordingJob(); });
+
+    const int numChainJobs = 20000;
+    JobRunID runID = jobSystem->CreateGraphRun();
+    nlohmann::json input = nlohmann::json::object();
+    std::vector<JobID> chainJobs;
+    for (int i = 0; i < numChainJobs; ++i)
+    {
+        std::string jobName = "chain" + std::to_string(i);
+        chainJobs.push_back(jobSystem->CreateJob("record", input, runID, jobName)["jobId"].get<JobID>());
+        if (i > 0)
+        {
+            jobSystem->SetDependency(runID, jobName, "chain" + std::to_string(i - 1));
+        }
+        jobSystem->QueueJob(chainJobs.back());
+    }
+
+    Expect(jobSystem->CancelJob(chainJobs.front()), "the first job of the chain is cancelled");
+    Expect(!jobSystem->CancelJob(chainJobs.back()), "the last job of the chain was cancelled with it");
+    delete jobSystem;
+}
+
+// Runs that never get a job are let go, by CloseGraphRun or by an empty batch that never opens one
+static void TestEmptyGraphRunsAreForgotten()
+{
+    JobSystem *jobSystem = new JobSystem();
+    size_t numGraphRuns = jobSystem->GetMetrics()["graphRuns"].get<size_t>();
+
+    JobRunID runID = jobSystem->CreateGraphRun();
+    Expect(jobSystem->GetMetrics()["graphRuns"].get<size_t>() == numGraphRuns + 1, "a created run is open");
+    jobSystem->CloseGraphRun(runID);
+    Expect(jobSystem->GetMetrics()["graphRuns"].get<size_t>() == numGraphRuns, "a closed run without jobs is forgotten");
+
+    nlohmann::json graphSpec = {{"runId", runID}, {"jobs", nlohmann::json::array()}};
+    Expect(jobSystem->SubmitGraph(graphSpec).contains("error"), "a closed run takes no more jobs");
+
+    nlohmann::json emptyGraphSpec = {{"jobs", nlohmann::json::array()}};
+    Expect(!jobSystem->SubmitGraph(emptyGraphSpec).contains("error"), "an empty graph is submitted");
+    Expect(jobSystem->GetMetrics()["graphRuns"].get<size_t>() == numGraphRuns, "an empty graph leaves no run behind");
+    delete jobSystem;
+}
+
+int main()
+{
+    TestDependentWaitsForQueueJob();
+    TestLowPriorityJobOvertakesLocalWork();
+    TestCancelLongChain();
+    TestEmptyGraphRunsAreForgotten();
+
+    if (s_numFailures > 0)
+    {
+        std::cerr << s_numFailures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "jobsystemtest passed" << std::endl;
+    return 0;
+}
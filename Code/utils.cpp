@@ -2,12 +2,10 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <thread>
 #include <set>
-#include <chrono>
-#include <filesystem>
 #include "./lib/jobsystemapi.h"
 #include "customjob.h"
+#include "correctionjob.h"
 #include "compilejob.h"
 #include "parsingjob.h"
 #include "outputjob.h"
@@ -32,7 +30,7 @@ void cleanupDataFiles(const std::vector<std::string> &fileNames)
     }
 }
 
-void registerAndQueueJobs(JobSystemAPI *jobSystem, nlohmann::json &flowscriptJobOutput)
+std::vector<JobHandle> registerAndQueueJobs(JobSystemAPI *jobSystem, nlohmann::json &flowscriptJobOutput)
 {
     std::map<std::string, std::function<Job *()>> jobFactories = {
         {"compileJob", []() -> Job *
@@ -42,8 +40,12 @@ void registerAndQueueJobs(JobSystemAPI *jobSystem, nlohmann::json &flowscriptJob
         {"parseOutputJob", []() -> Job *
          { return new OutputJob(); }}};
 
+    // Every fix iteration runs the same graph, its job types are registered on the first one
     std::set<std::string> registeredJobs;
-    std::map<std::string, int> jobIds;
+    for (const auto &jobType : jobSystem->GetJobTypes()["availableJobTypes"])
+    {
+        registeredJobs.insert(jobType.get<std::string>());
+    }
     std::map<std::string, nlohmann::json> dataNodes;
 
     // First pass: Handle data nodes and register jobs
@@ -75,7 +77,11 @@ void registerAndQueueJobs(JobSystemAPI *jobSystem, nlohmann::json &flowscriptJob
         }
     }
 
-    // Second pass: Create jobs and set dependencies
+    // Second pass: Describe the executable jobs and their dependencies, then submit them in one batch
+    nlohmann::json graphSpec;
+    graphSpec["jobs"] = nlohmann::json::array();
+    graphSpec["edges"] = nlohmann::json::array();
+
     for (const auto &el : flowscriptJobOutput.items())
     {
         const std::string &jobName = el.key();
@@ -93,10 +99,25 @@ void registerAndQueueJobs(JobSystemAPI *jobSystem, nlohmann::json &flowscriptJob
                 }
             }
 
-            auto creationResult = jobSystem->CreateJob(jobName.c_str(), jobInput);
-            int createdJobId = creationResult["jobId"];
-            jobIds[jobName] = createdJobId;
-            std::cout << "Created job: " << jobName << " with ID: " << createdJobId << std::endl;
+            // Scheduling hints from the node attributes, read when the job is created
+            if (jobInfo.contains("priority"))
+            {
+                jobInput["priority"] = jobInfo["priority"];
+            }
+            if (jobInfo.contains("deadlineMs"))
+            {
+                jobInput["deadlineMs"] = jobInfo["deadlineMs"];
+            }
+            if (jobInfo.contains("retries"))
+            {
+                jobInput["retry"] = {{"maxAttempts", jobInfo["retries"].get<int>() + 1}};
+            }
+
+            nlohmann::json jobSpec;
+            jobSpec["name"] = jobName;
+            jobSpec["type"] = jobName;
+            jobSpec["input"] = std::move(jobInput);
+            graphSpec["jobs"].push_back(std::move(jobSpec));
 
             for (const auto &dep : jobInfo["dependencies"])
             {
@@ -115,10 +136,14 @@ void registerAndQueueJobs(JobSystemAPI *jobSystem, nlohmann::json &flowscriptJob
                         }
                     }
 
-                    if (!actualDependency.empty() && actualDependency != jobName)
+                    // Data nodes were merged into the input above, only jobs become edges
+                    if (!actualDependency.empty() && actualDependency != jobName &&
+                        flowscriptJobOutput.contains(actualDependency) && flowscriptJobOutput[actualDependency]["type"] == 1)
                     {
-                        jobSystem->SetDependency(jobName.c_str(), actualDependency.c_str());
-                        std::cout << "Set dependency for " << jobName << " on " << actualDependency << std::endl;
+                        nlohmann::json edgeSpec;
+                        edgeSpec["dependent"] = jobName;
+                        edgeSpec["dependency"] = actualDependency;
+                        graphSpec["edges"].push_back(std::move(edgeSpec));
                     }
                 }
                 else
@@ -126,25 +151,26 @@ void registerAndQueueJobs(JobSystemAPI *jobSystem, nlohmann::json &flowscriptJob
                     std::cerr << "Dependency key not found: " << depKey << std::endl;
                 }
             }
+        }
+    }
 
-            bool shouldQueue = true;
-            for (const auto &dep : jobInfo["dependencies"])
-            {
-                std::string depKey = dep.get<std::string>();
-                if (flowscriptJobOutput.contains(depKey) && flowscriptJobOutput[depKey]["type"] != 0)
-                {
-                    shouldQueue = false;
-                    break;
-                }
-            }
+    // Jobs without job dependencies start right away, the rest start as their dependencies complete
+    nlohmann::json submission = jobSystem->SubmitGraph(graphSpec);
+    if (submission.contains("error"))
+    {
+        std::cerr << "Failed to submit FlowScript graph: " << submission["error"] << std::endl;
+        return {};
+    }
+    // Each pass of the compile-fix loop is its own run, so its job names never resolve to an older pass
+    std::cout << "Queued run " << submission["runId"] << ": " << graphSpec["jobs"].size() << " jobs with "
+              << graphSpec["edges"].size() << " dependencies: " << submission["jobIds"].dump() << std::endl;
 
-            if (shouldQueue)
-            {
-                jobSystem->QueueJob(jobIds[jobName]);
-                std::cout << "Queued job: " << jobName << std::endl;
-            }
-        }
+    std::vector<JobHandle> jobHandles;
+    for (const auto &jobID : submission["jobIds"])
+    {
+        jobHandles.push_back(jobSystem->GetJobHandle(jobID.get<JobID>()));
     }
+    return jobHandles;
 }
 
 bool hasCompilationErrors(const std::string &errorReportPath)
@@ -195,19 +221,7 @@ bool hasCompilationErrors(const std::string &errorReportPath)
     }
 }
 
-bool isFileUpdated(const std::string &filePath, const std::time_t &lastModifiedTime)
-{
-    std::filesystem::path path(filePath);
-    if (!std::filesystem::exists(path))
-    {
-        return false;
-    }
-
-    auto currentModifiedTime = std::filesystem::last_write_time(path).time_since_epoch().count();
-    return currentModifiedTime > lastModifiedTime;
-}
-
-void runFlowScript(JobSystemAPI &jobSystem, const std::string &flowscriptText)
+void runFlowScript(JobSystemAPI &jobSystem, const std::string &flowscriptText, PipelineLatencyReport &latencyReport)
 {
     // Truncate the error report file at the start of the program
     std::ofstream jsonFile("./Data/error_report.json", std::ios::out | std::ios::trunc);
@@ -218,31 +232,37 @@ void runFlowScript(JobSystemAPI &jobSystem, const std::string &flowscriptText)
     jsonFile.close();
 
     // Create and enqueue a flowscript parse job
-    nlohmann::json flowscriptJobInput = {{"flowscript", flowscriptText}};
+    // Each fix iteration starts with this parse, let it jump ahead of slow background jobs
+    nlohmann::json flowscriptJobInput = {{"flowscript", flowscriptText}, {"priority", "high"}};
     nlohmann::json flowscriptJobCreation = jobSystem.CreateJob("flowscriptJob", flowscriptJobInput);
     std::cout << "Creating FlowScript Parse Job: " << flowscriptJobCreation.dump(4) << std::endl;
 
-    jobSystem.QueueJob(flowscriptJobCreation["jobId"]);
+    JobHandle flowscriptJobHandle = jobSystem.QueueJob(flowscriptJobCreation["jobId"]);
     std::cout << "Queuing FlowScript Parse Job with ID: " << flowscriptJobCreation["jobId"] << std::endl;
 
-    std::cout << "Enter job ID to finish a specific job: \n";
-    std::string jobID;
-    std::cin >> jobID;
-
-    nlohmann::json flowscriptFinish = jobSystem.FinishJob(jobID);
+    // Blocks until the parse job completes, then runs its callback which stores the output
+    JobID jobID = flowscriptJobHandle.GetJobID();
+    PipelineLatencyReport::TimePoint waitStartTime = std::chrono::steady_clock::now();
+    nlohmann::json flowscriptFinish = jobSystem.FinishJob(flowscriptJobHandle);
+    latencyReport.RecordStage(flowscriptFinish, waitStartTime);
     std::cout << "Finishing Job " << jobID << " with result: " << flowscriptFinish.dump(4) << std::endl;
 
     // Now retrieve the output of the finished job
-    nlohmann::json flowscriptJobOutput = jobSystem.GetJobOutput(stoi(jobID));
+    nlohmann::json flowscriptJobOutput = jobSystem.GetJobOutput(jobID);
     if (!flowscriptJobOutput.empty())
     {
         // Process the output, e.g., for job queuing and dependency setting
         std::cout << "\nEnqueuing Jobs from FlowScript Graph! \n"
                   << std::endl;
-        registerAndQueueJobs(&jobSystem, flowscriptJobOutput);
+        std::vector<JobHandle> flowJobHandles = registerAndQueueJobs(&jobSystem, flowscriptJobOutput);
 
-        // Waiting for compile flow to complete and for error_report.json to be closed
-        std::this_thread::sleep_for(std::chrono::seconds(3));
+        // Wait for the compile flow to complete, the output jobs have closed error_report.json once they have
+        for (const JobHandle &flowJobHandle : flowJobHandles)
+        {
+            waitStartTime = std::chrono::steady_clock::now();
+            nlohmann::json flowJobFinish = jobSystem.FinishJob(flowJobHandle);
+            latencyReport.RecordStage(flowJobFinish, waitStartTime);
+        }
 
         // Check for compilation errors using hasCompilationErrors function
         if (!hasCompilationErrors("./Data/error_report.json"))
@@ -253,116 +273,42 @@ void runFlowScript(JobSystemAPI &jobSystem, const std::string &flowscriptText)
         else
         {
             /*
-        LLM Call node.js script
+        LLM Call and Code Correction node.js scripts
         */
-            std::cout << "Registering gptCall Job\n"
-                      << std::endl;
-
-            jobSystem.RegisterJob("gptCallJob", []() -> Job *
-                                  { return new CustomJob(); });
-
-            // Create gptCallJob job
-            nlohmann::json gptCallJobInput = {{"command", "node ./Code/gptCall.js -file ./Data/error_report.json"}};
-            nlohmann::json gptCallJobCreation = jobSystem.CreateJob("gptCallJob", gptCallJobInput);
-            std::cout << "Creating Node Job: " << gptCallJobCreation.dump(4) << std::endl;
-
-            /*
-             Code Correction node.js script
-            */
-            std::cout << "Registering codeCorrection Job" << std::endl;
-
-            jobSystem.RegisterJob("codeCorrectionJob", []() -> Job *
-                                  { return new CustomJob(); });
-
-            // Create codeCorrection job
-            nlohmann::json codeCorrectionJobInput = {{"command", "node ./Code/codeCorrection.js"}};
-            nlohmann::json codeCorrectionJobCreation = jobSystem.CreateJob("codeCorrectionJob", codeCorrectionJobInput);
-            std::cout << "Creating Node Job: " << codeCorrectionJobCreation.dump(4) << std::endl;
-
-            std::cout << "Queuing gptCall Job: \n"
-                      << std::endl;
-            jobSystem.QueueJob(gptCallJobCreation["jobId"]);
-
-            // Short delay before starting the polling
-            std::this_thread::sleep_for(std::chrono::seconds(2));
-
-            // Timeout duration is 30 seconds
-            const int timeoutDuration = 30;
-
-            // Start time for timeout calculation
-            auto startTime = std::chrono::high_resolution_clock::now();
-
-            // Polling for gptCall job completion
-            std::string correctedCodePath = "./Data/corrected_code.json";
-            std::string correctionHistoryPath = "./Data/correction_history.json";
-            std::string codeChangeDescriptionPath = "./Data/code_change_descriptions.txt";
-
-            std::time_t lastModifiedTimeCorrectedCode = std::filesystem::exists(correctedCodePath) ? std::filesystem::last_write_time(correctedCodePath).time_since_epoch().count() : 0;
-            std::time_t lastModifiedTimeCorrectionHistory = std::filesystem::exists(correctionHistoryPath) ? std::filesystem::last_write_time(correctionHistoryPath).time_since_epoch().count() : 0;
-            std::time_t lastModifiedTimeCodeChangeDescription = std::filesystem::exists(codeChangeDescriptionPath) ? std::filesystem::last_write_time(codeChangeDescriptionPath).time_since_epoch().count() : 0;
-
-            // Polling loop for gptCall job
-            while (true)
-            {
-                std::cout << "Polling for gptCall job completion..."
-                          << std::endl;
-
-                // Check if either file is updated
-                if (isFileUpdated(correctedCodePath, lastModifiedTimeCorrectedCode) && isFileUpdated(correctionHistoryPath, lastModifiedTimeCorrectedCode))
-                {
-                    std::cout << "File has been modified, breaking out of loop: \n"
-                              << std::endl;
-                    // Exit loop if files are updated
-                    break;
-                }
-
-                // Check for timeout
-                auto currentTime = std::chrono::high_resolution_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(currentTime - startTime).count();
-                if (elapsed >= timeoutDuration)
-                {
-                    std::cerr << "Timeout reached while waiting for gptCallJob.\n";
-                    break;
-                }
-
-                // Sleep for a short duration before next check
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-            }
-
-            // Sleep for a short duration before queuing codeCorrection job
-            std::this_thread::sleep_for(std::chrono::seconds(5));
-
-            std::cout << "Queuing codeCorrection Job: \n"
+            // Create correction job, it runs gptCall and then codeCorrection as soon as the first exits
+            // The LLM call is slow, keep it from holding up parse and output jobs on the critical path.
+            // Each script used to get 30 seconds, a hung one is now killed instead of waited out
+            nlohmann::json correctionJobInput = {{"gptCallCommand", "node ./Code/gptCall.js -file ./Data/error_report.json"},
+                                                 {"codeCorrectionCommand", "node ./Code/codeCorrection.js"},
+                                                 {"priority", "low"},
+                                                 {"timeoutMs", 60000}};
+            nlohmann::json correctionJobCreation = jobSystem.CreateJob("correctionJob", correctionJobInput);
+            std::cout << "Creating Correction Job: " << correctionJobCreation.dump(4) << std::endl;
+
+            std::cout << "Queuing Correction Job: \n"
                       << std::endl;
-            jobSystem.QueueJob(codeCorrectionJobCreation["jobId"]);
+            JobHandle correctionJobHandle = jobSystem.QueueJob(correctionJobCreation["jobId"]);
 
-            // Reset start time for the next job's timeout
-            startTime = std::chrono::high_resolution_clock::now();
+            // Blocks until both scripts have exited, the corrected code and its description are written by then
+            waitStartTime = std::chrono::steady_clock::now();
+            nlohmann::json correctionFinish = jobSystem.FinishJob(correctionJobHandle);
+            std::cout << "Finishing Correction Job with result: " << correctionFinish.dump(4) << std::endl;
 
-            // Polling loop for codeCorrection job
-            while (true)
+            // The LLM call and the patch are one job, its output says how long each script ran
+            nlohmann::json correctionOutput = jobSystem.GetJobOutput(correctionJobHandle.GetJobID());
+            nlohmann::json correctionSteps;
+            if (correctionOutput.is_object())
             {
-                std::cout << "Polling for codeCorrection job completion..."
-                          << std::endl;
-                if (isFileUpdated(codeChangeDescriptionPath, lastModifiedTimeCodeChangeDescription))
+                if (correctionOutput.contains("gptCall"))
                 {
-                    std::cout << "code_change_descriptions.txt file has been modified, breaking out of loop: \n"
-                              << std::endl;
-                    break; // Exit loop if file is updated
+                    correctionSteps["llmCallMs"] = correctionOutput["gptCall"].value("durationMs", 0.0);
                 }
-
-                // Check for timeout
-                auto currentTime = std::chrono::high_resolution_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(currentTime - startTime).count();
-                if (elapsed >= timeoutDuration)
+                if (correctionOutput.contains("codeCorrection"))
                 {
-                    std::cerr << "Timeout reached while waiting for codeCorrectionJob.\n";
-                    break;
+                    correctionSteps["patchApplyMs"] = correctionOutput["codeCorrection"].value("durationMs", 0.0);
                 }
-
-                // Sleep for a short duration before next check
-                std::this_thread::sleep_for(std::chrono::seconds(1));
             }
+            latencyReport.RecordStage(correctionFinish, waitStartTime, correctionSteps);
         }
     }
     else
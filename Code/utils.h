@@ -4,11 +4,15 @@
 #include <string>
 #include "./lib/jobsystemapi.h"
 #include "nlohmann/json.hpp"
+#include "pipelinelatency.h"
 
-void registerAndQueueJobs(JobSystemAPI *jobSystem, nlohmann::json &flowscriptJobOutput);
+#include <vector>
+
+// Returns handles to every job it queued, empty if the graph was rejected
+std::vector<JobHandle> registerAndQueueJobs(JobSystemAPI *jobSystem, nlohmann::json &flowscriptJobOutput);
 bool hasCompilationErrors(const std::string &errorReportPath);
-void runFlowScript(JobSystemAPI &jobSystem, const std::string &flowscriptText);
-bool isFileUpdated(const std::string &filePath, const std::time_t &lastModifiedTime);
+// Every job it waits on is recorded as a stage of the latency report's current pass
+void runFlowScript(JobSystemAPI &jobSystem, const std::string &flowscriptText, PipelineLatencyReport &latencyReport);
 
 void cleanupDataFiles(const std::vector<std::string> &fileNames);
 